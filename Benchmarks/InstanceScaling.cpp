@@ -0,0 +1,244 @@
+// Multi-instance scaling benchmark: N processors in one process, rendered block by block
+// across a pool of worker threads the way a DAW's parallel graph runs them. Reports
+// construction and prepareToPlay time, resident memory per instance and throughput.
+//
+//   Buffr3Scaling [--max-instances 512] [--threads <cores>] [--block 256]
+//                 [--rate 48000] [--seconds 5] [--idle]
+//
+// Instance counts double from 1 to --max-instances. Unless --idle is given, every
+// instance receives a held note in its first block, so the loop path is measured.
+// Buffr3ScalingGeneric runs the same with the channel/seam specialisations compiled
+// out (BUFFR3_GENERIC_DSP); compare its ns/sample/inst column against Buffr3Scaling.
+
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include "../Source/PluginProcessor.h"
+
+#include <iostream>
+#include <thread>
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+#endif
+
+using namespace juce;
+
+// Resident set size in bytes, 0 where unsupported
+static int64 residentBytes()
+{
+   #if JUCE_LINUX
+    int64 pages = 0, resident = 0;
+    if (auto* f = std::fopen ("/proc/self/statm", "r"))
+    {
+        if (std::fscanf (f, "%lld %lld", &pages, &resident) != 2)
+            resident = 0;
+        std::fclose (f);
+    }
+    return resident * (int64) sysconf (_SC_PAGESIZE);
+   #elif JUCE_MAC
+    mach_task_basic_info info {};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info (mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS)
+        return 0;
+    return (int64) info.resident_size;
+   #else
+    return 0;
+   #endif
+}
+
+// Worker pool that renders every instance once per "graph cycle" and waits for all of them
+class GraphRunner
+{
+public:
+    GraphRunner (int numThreads, std::function<void (int)> renderOne)
+        : render (std::move (renderOne))
+    {
+        for (int i = 1; i < numThreads; ++i) // the calling thread is worker 0
+            workers.emplace_back ([this] { workerLoop(); });
+    }
+
+    ~GraphRunner()
+    {
+        quit.store (true);
+        cycle.fetch_add (1);
+        for (auto& t : workers)
+            t.join();
+    }
+
+    void runCycle (int numNodes)
+    {
+        // done first: a worker still leaving the previous cycle may claim from 'next' as soon
+        // as it is reset, and its completion must count
+        total.store (numNodes);
+        done.store (0);
+        next.store (0);
+        cycle.fetch_add (1, std::memory_order_release);
+
+        drain();
+        while (done.load (std::memory_order_acquire) < numNodes)
+            std::this_thread::yield();
+    }
+
+private:
+    void workerLoop()
+    {
+        auto seen = cycle.load();
+        for (;;)
+        {
+            while (cycle.load (std::memory_order_acquire) == seen)
+                std::this_thread::yield();
+            seen = cycle.load();
+
+            if (quit.load())
+                return;
+            drain();
+        }
+    }
+
+    void drain()
+    {
+        const int n = total.load();
+        for (int i = next.fetch_add (1); i < n; i = next.fetch_add (1))
+        {
+            render (i);
+            done.fetch_add (1, std::memory_order_release);
+        }
+    }
+
+    std::function<void (int)> render;
+    std::vector<std::thread> workers;
+    std::atomic<int> total { 0 }, next { 0 }, done { 0 };
+    std::atomic<uint32> cycle { 0 };
+    std::atomic<bool> quit { false };
+};
+
+struct Instance
+{
+    std::unique_ptr<Buffr3AudioProcessor> processor;
+    AudioBuffer<float> buffer;
+    MidiBuffer midi;
+    int64 blocksDone = 0;
+};
+
+// One second of two detuned partials; instances read it at different offsets so they
+// don't all process identical data, and the per-block cost is a plain copy
+static AudioBuffer<float> makeInput (double rate)
+{
+    AudioBuffer<float> input (2, (int) rate);
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        auto* d = input.getWritePointer (ch);
+        for (int i = 0; i < input.getNumSamples(); ++i)
+        {
+            const double t = i / rate;
+            d[i] = (float) (0.4 * std::sin (MathConstants<double>::twoPi * 110.0 * t)
+                          + 0.2 * std::sin (MathConstants<double>::twoPi * 221.0 * t + ch));
+        }
+    }
+    return input;
+}
+
+int main (int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInit; // parameter trees and caches expect a message manager
+
+    const ArgumentList args (argc, argv);
+    auto intArg = [&args] (const char* name, int fallback)
+    {
+        return args.containsOption (name) ? args.getValueForOption (name).getIntValue() : fallback;
+    };
+
+    const int maxInstances = jlimit (1, 4096, intArg ("--max-instances", 512));
+    const int numThreads   = jlimit (1, 256,  intArg ("--threads", (int) std::thread::hardware_concurrency()));
+    const int blockSize    = jlimit (16, 8192, intArg ("--block", 256));
+    const double rate      = (double) jlimit (8000, 384000, intArg ("--rate", 48000));
+    const double seconds   = (double) jlimit (1, 600, intArg ("--seconds", 5));
+    const bool idle        = args.containsOption ("--idle");
+
+    const int numCycles = (int) std::ceil (seconds * rate / blockSize);
+    const auto input = makeInput (rate);
+    const double blockSeconds = blockSize / rate;
+
+    std::cout << "threads=" << numThreads << " block=" << blockSize << " rate=" << rate
+              << " audio=" << seconds << "s " << (idle ? "idle" : "looping")
+              << " dsp=" << (BUFFR3_GENERIC_DSP ? "generic" : "specialised") << "\n"
+              << "instances, create ms/inst, prepare ms/inst, RSS MB/inst, realtime x, "
+                 "ns/sample/inst, worst cycle / deadline, late cycles\n";
+
+    for (int count = 1; count <= maxInstances; count *= 2)
+    {
+        std::vector<Instance> instances ((size_t) count);
+        const auto rssBefore = residentBytes();
+
+        // Construction
+        auto t0 = Time::getHighResolutionTicks();
+        for (auto& inst : instances)
+            inst.processor = std::make_unique<Buffr3AudioProcessor>();
+        const double createSec = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - t0);
+
+        // prepareToPlay
+        t0 = Time::getHighResolutionTicks();
+        for (auto& inst : instances)
+        {
+            inst.processor->setPlayConfigDetails (2, 2, rate, blockSize);
+            inst.processor->prepareToPlay (rate, blockSize);
+            inst.buffer.setSize (2, blockSize);
+        }
+        const double prepareSec = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - t0);
+        const auto rssAfter = residentBytes();
+
+        int64 cycleStart = 0;
+        auto renderOne = [&] (int i)
+        {
+            auto& inst = instances[(size_t) i];
+            const int inputLen = input.getNumSamples();
+            const int offset = (int) ((cycleStart + (int64) i * 997) % inputLen);
+            const int first = jmin (blockSize, inputLen - offset);
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                inst.buffer.copyFrom (ch, 0, input, ch, offset, first);
+                if (first < blockSize)
+                    inst.buffer.copyFrom (ch, first, input, ch, 0, blockSize - first);
+            }
+            inst.midi.clear();
+            if (! idle && inst.blocksDone == 0)
+                inst.midi.addEvent (MidiMessage::noteOn (1, 48 + i % 24, (uint8) 100), 0);
+            inst.processor->processBlock (inst.buffer, inst.midi);
+            ++inst.blocksDone;
+        };
+
+        double worstCycle = 0.0;
+        int lateCycles = 0;
+        t0 = Time::getHighResolutionTicks();
+        {
+            GraphRunner graph (numThreads, renderOne);
+            for (int c = 0; c < numCycles; ++c, cycleStart += blockSize)
+            {
+                const auto c0 = Time::getHighResolutionTicks();
+                graph.runCycle (count);
+                const double cycleSec = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - c0);
+                worstCycle = jmax (worstCycle, cycleSec);
+                lateCycles += cycleSec > blockSeconds ? 1 : 0;
+            }
+        }
+        const double wallSec = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - t0);
+
+        const double samples = (double) numCycles * blockSize * count;
+        std::cout << count
+                  << ", " << String (1000.0 * createSec / count, 3)
+                  << ", " << String (1000.0 * prepareSec / count, 3)
+                  << ", " << (rssAfter > 0 ? String ((double) (rssAfter - rssBefore) / count / (1024.0 * 1024.0), 2) : String ("n/a"))
+                  << ", " << String (seconds * count / wallSec, 1)
+                  << ", " << String (1.0e9 * wallSec / samples, 2)
+                  << ", " << String (worstCycle / blockSeconds, 2)
+                  << ", " << lateCycles << "/" << numCycles
+                  << std::endl;
+
+        for (auto& inst : instances)
+            inst.processor->releaseResources();
+    }
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include "DiskRecorder.h"
+#include <cstring>
+
+using namespace juce;
+
+// Keep this much of the in-memory ring between the audio thread's write head and
+// the writer's read position, so a late flush never copies half-overwritten audio.
+static int ringGuard (int ringSamples) { return ringSamples / 8; }
+
+// ===================== Lifecycle =====================
+bool DiskRecorder::prepare (const RecorderRing& src, int historySamples, int windowSamples)
+{
+    release();
+
+    source  = &src;
+    history = std::max (1, historySamples);
+    window  = std::max (1, windowSamples);
+    slack   = window / 4;
+
+    const int64 bytes = (int64) src.getNumChannels() * (int64) history * (int64) src.getBytesPerSample();
+
+    spillFile = File::getSpecialLocation (File::tempDirectory)
+                    .getNonexistentChildFile ("buffr3-recorder", ".raw", false);
+    {
+        // Size the file up front (sparse where the OS allows) so it can be mapped whole
+        FileOutputStream fos (spillFile);
+        if (fos.failedToOpen() || ! fos.setPosition (bytes - 1) || ! fos.writeByte (0))
+        {
+            release();
+            return false;
+        }
+    }
+
+    mapped = std::make_unique<MemoryMappedFile> (spillFile, MemoryMappedFile::readWrite, true);
+    if (mapped->getData() == nullptr || (int64) mapped->getSize() < bytes)
+    {
+        release();
+        return false;
+    }
+
+    for (auto& st : stages)
+    {
+        st.audio.setSize (src.getNumChannels(), window + slack);
+        st.startAbs = st.endAbs = 0;
+    }
+    publishedStage = -1;
+    readingStage = -1;
+    flushedAbs = 0;
+
+    startThread();
+    return true;
+}
+
+void DiskRecorder::release()
+{
+    stopThread (2000);
+    mapped.reset();
+
+    if (spillFile != File())
+        spillFile.deleteFile();
+
+    spillFile = File();
+    source = nullptr;
+    publishedStage = -1;
+}
+
+bool DiskRecorder::needsDisk (int captureOffsetSamples) const
+{
+    if (! isActive())
+        return false;
+
+    // The audio thread owns the ring and can read all of it; the guard only matters to the writer
+    return captureOffsetSamples + window > source->getNumSamples();
+}
+
+char* DiskRecorder::diskPointer (int channel, int diskPos) const
+{
+    const auto offset = ((int64) channel * history + diskPos) * (int64) source->getBytesPerSample();
+    return static_cast<char*> (mapped->getData()) + offset;
+}
+
+// ===================== Writer thread =====================
+void DiskRecorder::run()
+{
+    while (! threadShouldExit())
+    {
+        flush();
+        stage();
+        wait (10);
+    }
+}
+
+void DiskRecorder::flush()
+{
+    const int R = source->getNumSamples();
+    const int64 total = source->getTotalWritten();
+
+    // Fell too far behind: skip whatever the ring may already have overwritten
+    if (total - flushedAbs > R - ringGuard (R))
+        flushedAbs = total - (R - ringGuard (R));
+
+    while (flushedAbs < total)
+    {
+        const int ringPos = (int) (flushedAbs % R);
+        const int diskPos = (int) (flushedAbs % history);
+        const int run = (int) std::min ({ total - flushedAbs, (int64) (R - ringPos), (int64) (history - diskPos) });
+
+        // Raw copy: the spill file uses the ring's sample format
+        for (int ch = 0; ch < source->getNumChannels(); ++ch)
+            source->readRaw (ch, ringPos, diskPointer (ch, diskPos), run);
+
+        flushedAbs += run;
+    }
+}
+
+void DiskRecorder::stage()
+{
+    // Start staging a guard's width before captures actually need the disk, so the window is
+    // ready by the time they do; until then the in-memory ring covers the capture window
+    const int offset = captureOffset.load();
+    const int R = source->getNumSamples();
+    if (offset + window <= R - ringGuard (R))
+        return;
+
+    const int64 wantEnd = source->getTotalWritten() - offset;
+    const int64 start   = std::max (wantEnd - window, flushedAbs - history);
+    const int64 end     = std::min (wantEnd + slack, flushedAbs);
+    if (end - start < window)
+        return;
+
+    // Still good enough? Only restage once the wanted end drifts past half the slack.
+    const int pub = publishedStage.load();
+    if (pub >= 0 && stages[pub].startAbs <= wantEnd - window && stages[pub].endAbs >= std::min (end, wantEnd + slack / 2))
+        return;
+
+    const int w = pub == 0 ? 1 : 0;
+    if (readingStage.load() == w)
+        return; // audio thread is copying from it, try again next pass
+
+    // Decode [start, end) out of the mapped file. This is where pages get faulted in,
+    // on this thread, so the audio thread's copy below only ever touches RAM.
+    auto& st = stages[w];
+    const bool isInt16 = source->getFormat() == RecorderRing::Format::int16;
+    for (int ch = 0; ch < st.audio.getNumChannels(); ++ch)
+    {
+        auto* dst = st.audio.getWritePointer (ch);
+        for (int64 abs = start; abs < end;)
+        {
+            const int diskPos = (int) (abs % history);
+            const int run = (int) std::min (end - abs, (int64) (history - diskPos));
+            const char* src = diskPointer (ch, diskPos);
+
+            if (isInt16) RecorderRing::decodeInt16 (reinterpret_cast<const int16_t*> (src), dst, run);
+            else         std::memcpy (dst, src, sizeof (float) * (size_t) run);
+
+            dst += run;
+            abs += run;
+        }
+    }
+    st.startAbs = start;
+    st.endAbs   = end;
+    publishedStage.store (w);
+}
+
+// ===================== Audio thread =====================
+bool DiskRecorder::readWindow (int64 endAbs, float* const* dest, int numChannels, int numSamples)
+{
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        const int b = publishedStage.load();
+        if (b < 0)
+            return false;
+
+        // Claim the stage, then make sure the writer didn't republish in between
+        readingStage.store (b);
+        if (publishedStage.load() != b)
+        {
+            readingStage.store (-1);
+            continue;
+        }
+
+        // Only a window that lies wholly inside the stage; a stale one is no better than RAM
+        const auto& st = stages[b];
+        const bool ok = endAbs - numSamples >= st.startAbs && endAbs <= st.endAbs;
+        if (ok)
+        {
+            const int from = (int) (endAbs - numSamples - st.startAbs);
+            for (int ch = 0; ch < std::min (numChannels, st.audio.getNumChannels()); ++ch)
+                std::memcpy (dest[ch], st.audio.getReadPointer (ch, from), sizeof (float) * (size_t) numSamples);
+        }
+
+        readingStage.store (-1);
+        return ok;
+    }
+    return false;
+}
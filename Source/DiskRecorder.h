@@ -0,0 +1,60 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "RecorderRing.h"
+
+// Long-history extension of the in-memory recorder. A background thread copies
+// completed blocks from the RecorderRing into a memory-mapped spill file (same
+// sample format), and keeps the window around the current capture offset
+// decoded in RAM. The audio thread only ever touches that staged window.
+class DiskRecorder : private juce::Thread
+{
+public:
+    DiskRecorder() : juce::Thread ("Buffr3 disk recorder") {}
+    ~DiskRecorder() override { release(); }
+
+    // Message thread (prepareToPlay): create + map the spill file and start the writer.
+    // 'source' must stay allocated until release().
+    bool prepare (const RecorderRing& source, int historySamples, int windowSamples);
+    void release();
+
+    bool isActive() const                                  { return mapped != nullptr; }
+    int  getHistorySamples() const                         { return isActive() ? history : 0; }
+
+    // Audio thread: how far behind "now" the next capture will end (drives prefetching)
+    void setCaptureOffset (int samplesBeforeNow)           { captureOffset.store (samplesBeforeNow); }
+
+    // True when a capture this far back reaches past what the in-memory ring holds
+    bool needsDisk (int captureOffsetSamples) const;
+
+    // Audio thread, wait-free: copy numSamples ending at absolute sample endAbs from the
+    // staged window. Returns false, copying nothing, unless that window is wholly staged.
+    bool readWindow (juce::int64 endAbs, float* const* dest, int numChannels, int numSamples);
+
+private:
+    void run() override;
+    void flush();
+    void stage();
+    char* diskPointer (int channel, int diskPos) const;
+
+    struct Stage
+    {
+        juce::AudioBuffer<float> audio;
+        juce::int64 startAbs = 0, endAbs = 0;
+    };
+
+    const RecorderRing* source = nullptr;
+    juce::File spillFile;
+    std::unique_ptr<juce::MemoryMappedFile> mapped;
+    int history = 0;          // samples per channel in the spill file
+    int window = 0;           // snapshot window
+    int slack = 0;            // staged past the requested end so a late trigger still hits
+    juce::int64 flushedAbs = 0; // writer thread only
+
+    Stage stages[2];
+    std::atomic<int> publishedStage { -1 };
+    std::atomic<int> readingStage { -1 };
+    std::atomic<int> captureOffset { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (DiskRecorder)
+};
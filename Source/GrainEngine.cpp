@@ -0,0 +1,172 @@
+#include "GrainEngine.h"
+
+using namespace juce;
+
+// ===================== Setup =====================
+GrainEngine::GrainEngine()
+{
+    for (int w = 0; w < (int) Window::numWindows; ++w)
+    {
+        auto& table = windowTables[(size_t) w];
+        for (int i = 0; i <= windowTableSize; ++i)
+        {
+            const double x = (double) i / windowTableSize;
+            double v = 0.0;
+            switch ((Window) w)
+            {
+                case Window::hann:      v = 0.5 - 0.5 * std::cos (MathConstants<double>::twoPi * x); break;
+                case Window::gauss:     v = std::exp (-0.5 * std::pow ((x - 0.5) / 0.15, 2.0)); break;
+                case Window::trapezoid: v = jmin (1.0, jmin (x, 1.0 - x) / 0.1); break; // 10% linear ramps
+                case Window::numWindows: break;
+            }
+            table[(size_t) i] = (float) v;
+            windowMeans[(size_t) w] += (float) (v / (windowTableSize + 1));
+        }
+    }
+
+    reset();
+}
+
+void GrainEngine::prepare (double sampleRate)
+{
+    sr = sampleRate;
+    reset();
+}
+
+void GrainEngine::reset()
+{
+    numActive = 0;
+    numFree = maxGrains;
+    for (int i = 0; i < maxGrains; ++i)
+        freeList[(size_t) i] = maxGrains - 1 - i;
+
+    samplesToNextGrain = 0.0;
+}
+
+// ===================== Scheduling =====================
+void GrainEngine::spawn (int startDelay, int sourceEnd, const Settings& s, double interval)
+{
+    if (numFree == 0)
+        return; // pool exhausted: drop the grain rather than allocate
+
+    const int period = jmax (1, s.periodSamples);
+
+    // Two periods long, within [64 samples, 1 s], and never longer than the source allows
+    const int maxOut = (int) ((sourceEnd - 4) / jmax (0.01f, s.speed));
+    const int lengthOut = jmin (maxOut, jlimit (64, (int) sr, 2 * period));
+    if (lengthOut < 16)
+        return;
+
+    const int srcSpan = (int) std::ceil (lengthOut * s.speed) + 1;
+    const int spread  = jmax (0, jmin (4 * period, sourceEnd - srcSpan - 2));
+    const int jitterOffset = (int) (s.jitter * random.nextFloat() * (float) spread);
+
+    const int idx = freeList[(size_t) --numFree];
+    auto& g = pool[(size_t) idx];
+    g.readPos     = (double) jmax (0, sourceEnd - srcSpan - 1 - jitterOffset);
+    g.increment   = s.speed;
+    g.windowPos   = 0.0f;
+    g.windowInc   = (float) windowTableSize / (float) lengthOut;
+    g.samplesLeft = lengthOut;
+    g.startDelay  = startDelay;
+    g.window      = s.window;
+
+    // Keep the summed level roughly constant as grains pile up: overlapping grains add
+    // coherently without jitter (1/overlap) and more like noise with full jitter (1/sqrt)
+    const double overlap = jmax (1.0, (double) lengthOut / interval * windowMeans[(size_t) s.window]);
+    g.gain = (float) std::pow (overlap, -(1.0 - 0.5 * s.jitter));
+
+    active[(size_t) numActive++] = idx;
+}
+
+// ===================== Rendering =====================
+void GrainEngine::render (Grain& g, const AudioBuffer<float>& source, AudioBuffer<float>& out, int startSample, int num)
+{
+    const auto& table = windowTables[(size_t) g.window];
+    const int numOutCh = out.getNumChannels();
+    const int numSrcCh = source.getNumChannels();
+
+    while (num > 0)
+    {
+        const int n = jmin (num, scratchSize);
+
+        // Window segment from the table (linear between entries), grain gain folded in
+        float wp = g.windowPos;
+        for (int i = 0; i < n; ++i)
+        {
+            const int   wi = jmin ((int) wp, windowTableSize - 1);
+            const float wf = wp - (float) wi;
+            windowScratch[(size_t) i] = g.gain * (table[(size_t) wi] + wf * (table[(size_t) wi + 1] - table[(size_t) wi]));
+            wp += g.windowInc;
+        }
+        g.windowPos = wp;
+
+        // Speed 1 from an integer position reads the source directly; otherwise interpolate once per channel
+        const int  ip = (int) g.readPos;
+        const bool contiguous = g.increment == 1.0f && (double) ip == g.readPos;
+
+        for (int ch = 0; ch < numOutCh; ++ch)
+        {
+            const float* src = source.getReadPointer (jmin (ch, numSrcCh - 1));
+            const float* seg = src + ip;
+
+            if (! contiguous)
+            {
+                double rp = g.readPos;
+                for (int i = 0; i < n; ++i)
+                {
+                    const int   ri = (int) rp;
+                    const float rf = (float) (rp - ri);
+                    sourceScratch[(size_t) i] = src[ri] + rf * (src[ri + 1] - src[ri]);
+                    rp += g.increment;
+                }
+                seg = sourceScratch.data();
+            }
+
+            // out += source * window, SIMD
+            FloatVectorOperations::addWithMultiply (out.getWritePointer (ch, startSample), seg, windowScratch.data(), n);
+        }
+
+        g.readPos += (double) n * g.increment;
+        startSample += n;
+        num -= n;
+    }
+}
+
+void GrainEngine::process (const AudioBuffer<float>& source, int sourceEnd,
+                           AudioBuffer<float>& out, int numSamples, const Settings& s)
+{
+    sourceEnd = jlimit (0, source.getNumSamples(), sourceEnd);
+    if (sourceEnd < 64 || numSamples <= 0)
+        return;
+
+    // 1) Schedule every grain that starts inside this block (with its offset into the block)
+    const double interval = jmax (1.0, (double) jmax (1, s.periodSamples) / jmax (0.01f, s.density));
+    while (samplesToNextGrain < (double) numSamples)
+    {
+        spawn (jmax (0, (int) samplesToNextGrain), sourceEnd, s, interval);
+        const double jitterScale = 1.0 + s.jitter * (random.nextDouble() - 0.5);
+        samplesToNextGrain += interval * jitterScale;
+    }
+    samplesToNextGrain -= numSamples;
+
+    // 2) Render each grain over its part of the block, 3) return finished ones to the pool
+    int kept = 0;
+    for (int a = 0; a < numActive; ++a)
+    {
+        const int idx = active[(size_t) a];
+        auto& g = pool[(size_t) idx];
+
+        const int start = g.startDelay;
+        const int n = jmin (g.samplesLeft, numSamples - start);
+        if (n > 0)
+            render (g, source, out, start, n);
+
+        g.startDelay = 0;
+        g.samplesLeft -= jmax (0, n);
+
+        if (g.samplesLeft > 0) active[(size_t) kept++] = idx;
+        else                   freeList[(size_t) numFree++] = idx;
+    }
+    numActive = kept;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// Granular alternative to the single-cycle loop: sprays overlapping windowed grains
+// out of the snapshot at the squeeze/MIDI-derived period. Grains come from a fixed
+// pool and windows from precomputed tables, so process() never allocates.
+class GrainEngine
+{
+public:
+    enum class Window { hann = 0, gauss, trapezoid, numWindows };
+
+    static constexpr int maxGrains = 256;
+    static constexpr int windowTableSize = 2048;
+
+    struct Settings
+    {
+        int    periodSamples = 1;     // spawn period at density 1 (same as the loop length)
+        float  density = 4.0f;        // grains per period
+        float  jitter = 0.0f;         // [0, 1] spread of source position and spawn time
+        float  speed = 1.0f;          // source read increment
+        Window window = Window::hann;
+    };
+
+    GrainEngine();
+
+    // Message thread (prepareToPlay)
+    void prepare (double sampleRate);
+    void reset();
+
+    // Audio thread: add grains read from source[.., sourceEnd) into out[0, numSamples)
+    void process (const juce::AudioBuffer<float>& source, int sourceEnd,
+                  juce::AudioBuffer<float>& out, int numSamples, const Settings& settings);
+
+private:
+    struct Grain
+    {
+        double readPos = 0.0;         // in source samples
+        float  increment = 1.0f;
+        float  windowPos = 0.0f;      // in table entries
+        float  windowInc = 0.0f;
+        int    samplesLeft = 0;
+        int    startDelay = 0;        // samples into the current block before it starts
+        float  gain = 1.0f;
+        Window window = Window::hann;
+    };
+
+    void spawn (int startDelay, int sourceEnd, const Settings& settings, double interval);
+    void render (Grain& g, const juce::AudioBuffer<float>& source, juce::AudioBuffer<float>& out,
+                 int startSample, int num);
+
+    static constexpr int scratchSize = 512; // per-grain work is done in runs of at most this
+
+    std::array<Grain, maxGrains> pool;
+    std::array<int, maxGrains> active {};   // indices into pool, [0, numActive)
+    std::array<int, maxGrains> freeList {}; // indices into pool, [0, numFree)
+    int numActive = 0, numFree = 0;
+
+    std::array<std::array<float, windowTableSize + 1>, (size_t) Window::numWindows> windowTables {};
+    std::array<float, (size_t) Window::numWindows> windowMeans {};
+    std::array<float, scratchSize> windowScratch {};
+    std::array<float, scratchSize> sourceScratch {};
+
+    double sr = 44100.0;
+    double samplesToNextGrain = 0.0;
+    juce::Random random;
+
+    JUCE_DECLARE_NON_COPYABLE (GrainEngine)
+};
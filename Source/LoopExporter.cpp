@@ -0,0 +1,155 @@
+#include "LoopExporter.h"
+#include "LoopKernel.h"
+#include <juce_dsp/juce_dsp.h>
+
+using namespace juce;
+
+// How long an armed export waits for the audio thread to hand over its job
+static constexpr int handoverTimeoutMs = 2000;
+
+// ===================== Hand-over =====================
+bool LoopExporter::begin (const File& file, Callback onDone)
+{
+    if (isThreadRunning())
+        return false;
+
+    int expected = idle;
+    if (! state.compare_exchange_strong (expected, armed))
+        return false;
+
+    destination = file;
+    callback = std::move (onDone);
+    startThread (Thread::Priority::normal); // the copy-out holds the processor's buffers; keep it from starving
+    return true;
+}
+
+void LoopExporter::waitForCopy() const
+{
+    while (getPinned() != nullptr && isThreadRunning())
+        Thread::sleep (1);
+}
+
+void LoopExporter::submit (const Job& j)
+{
+    int expected = armed;
+    if (! state.compare_exchange_strong (expected, claimed, std::memory_order_acq_rel))
+        return;
+
+    job = j;
+    pinned.store (j.channels[0], std::memory_order_release);
+    state.store (ready, std::memory_order_release);
+}
+
+// ===================== Export thread =====================
+void LoopExporter::run()
+{
+    // Wait for the audio thread; give up if it never picks the request up (e.g. not processing)
+    const auto deadline = Time::getMillisecondCounter() + (uint32) handoverTimeoutMs;
+    while (state.load (std::memory_order_acquire) != ready)
+    {
+        if (threadShouldExit() || Time::getMillisecondCounter() > deadline)
+        {
+            int expected = armed;
+            if (state.compare_exchange_strong (expected, idle))
+            {
+                MessageManager::callAsync ([cb = callback, f = destination] { if (cb) cb (false, f); });
+                return;
+            }
+        }
+        wait (5);
+    }
+
+    // Copy out first so the audio thread gets its buffer back as soon as possible
+    AudioBuffer<float> source (jmax (1, job.numChannels), jmax (1, job.length));
+    source.clear();
+    for (int ch = 0; ch < job.numChannels; ++ch)
+        source.copyFrom (ch, 0, job.channels[ch], job.length);
+    pinned.store (nullptr, std::memory_order_release);
+
+    const bool ok = job.loopSamples > 0 ? write (renderLoop (source, job), job.sampleRate)
+                                        : write (source, job.sampleRate);
+
+    state.store (idle);
+    MessageManager::callAsync ([cb = callback, f = destination, ok] { if (cb) cb (ok, f); });
+}
+
+// One cycle exactly as the loop plays it, through the processor's own LoopKernel, so the
+// file loops seamlessly in a sampler
+AudioBuffer<float> LoopExporter::renderLoop (const AudioBuffer<float>& source, const Job& j)
+{
+    const int N = source.getNumSamples();
+    const int L = jlimit (1, N, j.loopSamples);
+    const LoopKernel::Loop loop { N - L, L, j.xfadeSamples, N }; // the loop ends with the source
+    const int numCh = jmin (source.getNumChannels(), LoopKernel::maxChannels);
+    const float speed = jmax (0.01f, j.speed);
+    const int outLen = jmax (1, (int) std::ceil ((double) L / speed));
+
+    // Renders from pos, wrapping at the loop end as the processor does
+    auto render = [&] (float* const* dest, int numSamples, float& pos, float step)
+    {
+        float* dst[LoopKernel::maxChannels] {};
+        for (int done = 0; done < numSamples;)
+        {
+            for (int ch = 0; ch < numCh; ++ch)
+                dst[ch] = dest[ch] + done;
+
+            done += j.cubic ? LoopKernel::render<0, true, true>  (source.getArrayOfReadPointers(), dst, numCh, numSamples - done, loop, pos, step)
+                            : LoopKernel::render<0, true, false> (source.getArrayOfReadPointers(), dst, numCh, numSamples - done, loop, pos, step);
+            if (pos >= (float) L)
+                pos -= (float) L;
+        }
+    };
+
+    AudioBuffer<float> out (numCh, outLen);
+    out.clear();
+
+    if (! j.oversampled)
+    {
+        float pos = 0.0f;
+        render (out.getArrayOfWritePointers(), outLen, pos, speed);
+        return out;
+    }
+
+    // High above unity speed: half speed into a 2x block, band-limited on the way down. The
+    // first pass settles the filters on the cycle itself; the second is the one kept.
+    dsp::Oversampling<float> oversampler ((size_t) numCh, 1, dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, true);
+    oversampler.initProcessing ((size_t) outLen);
+    dsp::AudioBlock<float> block (out);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        auto up = oversampler.processSamplesUp (block);
+
+        float* upChans[LoopKernel::maxChannels] {};
+        for (size_t ch = 0; ch < up.getNumChannels(); ++ch)
+            upChans[ch] = up.getChannelPointer (ch);
+
+        float pos = 0.0f;
+        render (upChans, (int) up.getNumSamples(), pos, speed * 0.5f);
+        oversampler.processSamplesDown (block);
+    }
+
+    return out;
+}
+
+bool LoopExporter::write (const AudioBuffer<float>& audio, double sampleRate) const
+{
+    AudioFormatManager fm; fm.registerBasicFormats();
+    auto* format = fm.findFormatForFileExtension (destination.getFileExtension());
+    if (format == nullptr)
+        format = fm.getDefaultFormat(); // WAV
+
+    destination.deleteFile();
+    std::unique_ptr<FileOutputStream> stream (destination.createOutputStream());
+    if (stream == nullptr)
+        return false;
+
+    std::unique_ptr<AudioFormatWriter> writer (format->createWriterFor (stream.get(), sampleRate,
+                                                                        (unsigned int) audio.getNumChannels(),
+                                                                        24, {}, 0));
+    if (writer == nullptr)
+        return false;
+
+    stream.release(); // now owned by the writer
+    return writer->writeFromAudioSampleBuffer (audio, 0, audio.getNumSamples());
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <juce_audio_formats/juce_audio_formats.h>
+
+// Saves the playing loop or the raw snapshot to WAV/FLAC without a real-time bounce.
+// The audio thread hands over one Job that points at audio it then leaves untouched
+// (getPinned()) until the exporter has copied it; rendering and file I/O happen on
+// the exporter's own thread, which only runs while an export is in flight.
+class LoopExporter : private juce::Thread
+{
+public:
+    struct Job
+    {
+        const float* channels[2] {};
+        int    numChannels = 0;
+        int    length = 0;           // source is [0, length), newest audio last
+        int    loopSamples = 0;      // 0 => write the source as is (raw snapshot)
+        int    xfadeSamples = 0;
+        bool   cubic = false;        // Hermite instead of linear interpolation (High tier)
+        bool   oversampled = false;  // rendered at 2x, as High plays above unity speed
+        float  speed = 1.0f;
+        double sampleRate = 44100.0;
+    };
+
+    using Callback = std::function<void (bool ok, const juce::File& file)>; // message thread
+
+    LoopExporter() : juce::Thread ("Buffr3 exporter") {}
+    ~LoopExporter() override                               { stopThread (4000); }
+
+    // Message thread: arm an export to 'file' (extension picks WAV or FLAC). The job
+    // itself follows from the audio thread via submit(). False if one is still running.
+    bool begin (const juce::File& file, Callback onDone);
+
+    // Audio thread, wait-free. Ignored unless an export is armed.
+    void submit (const Job& job);
+
+    // First channel of the audio a submitted job still reads from, or nullptr
+    const float* getPinned() const                         { return pinned.load (std::memory_order_acquire); }
+
+    // Blocks until a submitted job has been copied out (well under a millisecond); returns
+    // at once if nothing is pinned. For callers about to overwrite or free that audio.
+    void waitForCopy() const;
+
+private:
+    void run() override;
+    bool write (const juce::AudioBuffer<float>& audio, double sampleRate) const;
+    static juce::AudioBuffer<float> renderLoop (const juce::AudioBuffer<float>& source, const Job& job);
+
+    enum State { idle = 0, armed, claimed, ready };
+
+    std::atomic<int> state { idle };
+    std::atomic<const float*> pinned { nullptr };
+    Job job;                                               // written by the audio thread between claimed and ready
+
+    juce::File destination;                                // message thread -> exporter thread (before startThread)
+    Callback callback;
+
+    JUCE_DECLARE_NON_COPYABLE (LoopExporter)
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <array>
+
+// Single-cycle loop rendering, shared by the processor and the exporter so an exported loop
+// is the loop as heard: same interpolation, tap wrapping and end -> start crossfade.
+namespace LoopKernel
+{
+    static constexpr int maxChannels = 2;
+
+    // 4-point, 3rd-order Hermite (Catmull-Rom) between x0 and x1
+    inline float hermite (float xm1, float x0, float x1, float x2, float t)
+    {
+        const float c1 = 0.5f * (x1 - xm1);
+        const float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+        const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+        return ((c3 * t + c2) * t + c1) * t + x0;
+    }
+
+    // Cubic selects Hermite over linear interpolation (High tier)
+    template <bool Cubic>
+    inline float read (const float* src, int im1, int i0, int i1, int i2, float frac)
+    {
+        if constexpr (Cubic) return hermite (src[im1], src[i0], src[i1], src[i2], frac);
+        else                 return src[i0] + frac * (src[i1] - src[i0]);
+    }
+
+    // One cycle: [start, start + length) of a snapshot numSnapshotSamples long, the last
+    // xfade samples crossfaded into the audio just before start
+    struct Loop
+    {
+        int start = 0;
+        int length = 1;
+        int xfade = 0;
+        int numSnapshotSamples = 1;
+    };
+
+    // Renders up to numSamples from pos (in [0, length)), advancing it by speed per sample.
+    // Stops right after the sample that takes pos to the loop end, so the caller can pick the
+    // next cycle; returns the number of samples written. NumCh > 0 fixes the channel count at
+    // compile time; Seam = false is only for runs that stay clear of the crossfade zone and
+    // the loop end. Everything the sample loop touches is a local, so stores through dst
+    // can't force reloads.
+    template <int NumCh, bool Seam, bool Cubic>
+    int render (const float* const* source, float* const* dest, int numChannels, int numSamples,
+                const Loop& loop, float& readPos, float speed)
+    {
+        const int numCh = NumCh > 0 ? NumCh : std::min (numChannels, maxChannels);
+        std::array<const float*, maxChannels> src {};
+        std::array<float*, maxChannels> dst {};
+        for (int ch = 0; ch < numCh; ++ch)
+        {
+            src[(size_t) ch] = source[ch];
+            dst[(size_t) ch] = dest[ch];
+        }
+
+        const int N = loop.numSnapshotSamples;
+        const int L = std::max (1, loop.length);
+        const int s = loop.start;
+        const int xfade = loop.xfade;
+        float pos = readPos;
+
+        int i = 0;
+        while (i < numSamples)
+        {
+            const int ip = (int) pos;
+            const float frac = pos - (float) ip;
+
+            if constexpr (! Seam)
+            {
+                // The tap before the first sample is the last one
+                const int idx0 = s + ip;
+                const int idxm1 = ip > 0 ? idx0 - 1 : s + L - 1;
+                for (int ch = 0; ch < numCh; ++ch)
+                    dst[(size_t) ch][i] = read<Cubic> (src[(size_t) ch], idxm1, idx0, idx0 + 1, idx0 + 2, frac);
+
+                pos += speed;
+                ++i;
+            }
+            else
+            {
+                // Taps wrap back into the loop; modulo, since in a very short loop (down to one
+                // sample) they can land more than one length past the end
+                const int idxm1 = s + (ip + L - 1) % L;
+                const int idx0  = s + ip % L;
+                const int idx1  = s + (ip + 1) % L;
+                const int idx2  = s + (ip + 2) % L;
+
+                const int samplesLeft = L - 1 - ip;
+
+                if (samplesLeft >= xfade)
+                {
+                    // Clean seams have no crossfade at all
+                    for (int ch = 0; ch < numCh; ++ch)
+                        dst[(size_t) ch][i] = read<Cubic> (src[(size_t) ch], idxm1, idx0, idx1, idx2, frac);
+                }
+                else
+                {
+                    // Crossfade near the end
+                    const float xfadeA = std::clamp ((float) samplesLeft / (float) std::max (1, xfade), 0.0f, 1.0f);
+                    const float xfadeB = 1.0f - xfadeA;
+
+                    // Pre-read from start for crossfade-in
+                    int cidx0 = s + (ip + 1 - L);
+                    while (cidx0 < 0) cidx0 += N;
+                    if (cidx0 >= N) cidx0 -= N;
+                    const int cidxm1 = cidx0 > 0 ? cidx0 - 1 : N - 1;
+                    const int cidx1  = cidx0 + 1 < N ? cidx0 + 1 : cidx0 + 1 - N;
+                    const int cidx2  = cidx1 + 1 < N ? cidx1 + 1 : cidx1 + 1 - N;
+
+                    for (int ch = 0; ch < numCh; ++ch)
+                    {
+                        const float sampA = read<Cubic> (src[(size_t) ch], idxm1, idx0, idx1, idx2, frac);
+                        const float sampB = read<Cubic> (src[(size_t) ch], cidxm1, cidx0, cidx1, cidx2, frac);
+                        dst[(size_t) ch][i] = sampA * xfadeA + sampB * xfadeB;
+                    }
+                }
+
+                pos += speed;
+                ++i;
+                if (pos >= (float) L)
+                    break;
+            }
+        }
+
+        readPos = pos;
+        return i;
+    }
+}
@@ -0,0 +1,72 @@
+#include "OnsetDetector.h"
+
+using namespace juce;
+
+void OnsetDetector::prepare (double sampleRate)
+{
+    slowCoeff = (float) (1.0 - std::exp (-(double) frameSize / (0.1 * sampleRate))); // ~100 ms average
+    refractorySamples = (int) (0.05 * sampleRate);                                     // 50 ms between onsets
+    reset();
+}
+
+void OnsetDetector::reset()
+{
+    framePower.fill (0.0f);
+    frameFill = 0;
+    slowPower = 0.0f;
+    refractory = 2 * refractorySamples; // let the running average settle before the first onset
+}
+
+bool OnsetDetector::process (const float* const* channels, int numChannels, int numSamples,
+                             int64 startAbs, int64& onsetAbs)
+{
+    bool fired = false;
+    int i = 0;
+
+    while (i < numSamples)
+    {
+        // Fill the current frame (frames may straddle calls)
+        const int n = jmin (frameSize - frameFill, numSamples - i);
+        float* p = framePower.data() + frameFill;
+        std::fill (p, p + n, 0.0f);
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const float* x = channels[ch] + i;
+            for (int k = 0; k < n; ++k)
+                p[k] += x[k] * x[k];
+        }
+
+        frameFill += n;
+        i += n;
+        if (frameFill < frameSize)
+            break;
+        frameFill = 0;
+
+        float lanes[4] = {};
+        for (int k = 0; k < frameSize; k += 4)
+            for (int l = 0; l < 4; ++l)
+                lanes[l] += framePower[(size_t) (k + l)];
+        const float power = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) / (float) frameSize;
+
+        if (refractory > 0)
+        {
+            refractory -= frameSize;
+        }
+        else if (! fired && power > floorPower && power > ratio * slowPower)
+        {
+            // The frame mean is above the level, so at least one sample is too
+            const float level = ratio * slowPower;
+            int k = 0;
+            while (k < frameSize - 1 && framePower[(size_t) k] <= level)
+                ++k;
+
+            onsetAbs = startAbs + i - frameSize + k;
+            fired = true;
+            refractory = refractorySamples;
+        }
+
+        slowPower += (power - slowPower) * slowCoeff;
+    }
+
+    return fired;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <juce_core/juce_core.h>
+
+// Energy-flux onset detector for audio-triggered captures. Power is averaged over short
+// frames and compared against a slow running average; when a frame rises far enough
+// above it, the onset is placed on the first sample of that frame that crosses the
+// threshold, so the reported position is sample accurate. It runs on the audio thread
+// right after the recorder write, at a cost of a couple of multiply-adds per sample.
+class OnsetDetector
+{
+public:
+    static constexpr int frameSize = 16;
+
+    // Message thread (prepareToPlay)
+    void prepare (double sampleRate);
+    void reset();
+
+    // Rise of frame power over the running average needed to fire, in dB
+    void setThresholdDb (float db)                         { ratio = std::pow (10.0f, db / 10.0f); }
+
+    // Audio thread: scan a block whose first sample has absolute index startAbs.
+    // Returns true and sets onsetAbs when an onset fires (at most one per call).
+    bool process (const float* const* channels, int numChannels, int numSamples,
+                  juce::int64 startAbs, juce::int64& onsetAbs);
+
+private:
+    std::array<float, frameSize> framePower {}; // per-sample power (summed over channels)
+    int   frameFill = 0;
+    float slowPower = 0.0f;
+    float slowCoeff = 0.01f;
+    float ratio = 16.0f;
+    int   refractory = 0, refractorySamples = 2048;
+
+    static constexpr float floorPower = 1.0e-6f; // -60 dBFS: ignore onsets in near-silence
+};
@@ -9,6 +9,193 @@ static void styleKnob (Slider& s)
     s.setTextBoxStyle (Slider::TextBoxBelow, true, 64, 18);
 }
 
+// ===================== Waveform views =====================
+WaveformView::WaveformView (Buffr3AudioProcessor& p, bool isSnapshot)
+: proc (p), snapshotView (isSnapshot)
+{
+    setOpaque (true);
+    renderThread->addTimeSliceClient (this);
+}
+
+WaveformView::~WaveformView()
+{
+    renderThread->removeTimeSliceClient (this); // waits if it's rendering right now
+    cancelPendingUpdate();
+}
+
+void WaveformView::resized()
+{
+    viewWidth  = getWidth();
+    viewHeight = getHeight();
+    renderThread->moveToFrontOfQueue (this);
+}
+
+int WaveformView::useTimeSlice()
+{
+    const int w = viewWidth.load(), h = viewHeight.load();
+    if (w <= 0 || h <= 0)
+        return 100;
+
+    // prepareToPlay reallocates the buffers we read: skip this pass rather than wait for it
+    const ScopedTryLock sl (proc.getDisplayLock());
+    if (! sl.isLocked())
+        return 30;
+
+    if (work.getWidth() != w || work.getHeight() != h)
+    {
+        work = Image (Image::ARGB, w, h, true, SoftwareImageType());
+        renderedGeneration = -1; // full redraw
+    }
+
+    if (snapshotView ? renderSnapshot (w, h) : renderRecorder (w, h))
+        publish();
+
+    return 30; // ms until we look for new data again
+}
+
+void WaveformView::publish()
+{
+    auto frame = work.createCopy(); // work keeps being drawn into; hand out a private copy
+    {
+        const SpinLock::ScopedLockType sl (imageLock);
+        std::swap (image, frame);
+    }
+    triggerAsyncUpdate();
+}
+
+void WaveformView::drawColumn (Graphics& g, int x, int h, float lo, float hi) const
+{
+    const float mid = h * 0.5f;
+    const float top = mid - jlimit (-1.0f, 1.0f, hi) * mid;
+    const float bot = mid - jlimit (-1.0f, 1.0f, lo) * mid;
+    g.drawVerticalLine (x, top, jmax (top + 1.0f, bot));
+}
+
+bool WaveformView::renderSnapshot (int w, int h)
+{
+    // Only when a capture, recall or WAV load changed what the snapshot shows
+    const int gen = proc.getSnapshotGeneration();
+    if (gen == renderedGeneration)
+        return false;
+    renderedGeneration = gen;
+
+    const auto& snap = proc.getSnapshotBuffer();
+    const int N = snap.getNumSamples();
+
+    work.clear (work.getBounds());
+    Graphics g (work);
+    g.setColour (Colours::cyan.withAlpha (0.8f));
+
+    for (int x = 0; x < w && N > 1; ++x)
+    {
+        const int from = (int) ((int64) x * N / w);
+        const int to   = jmax (from + 1, (int) ((int64) (x + 1) * N / w));
+        float lo = 0.0f, hi = 0.0f;
+        for (int ch = 0; ch < snap.getNumChannels(); ++ch)
+        {
+            const auto r = FloatVectorOperations::findMinAndMax (snap.getReadPointer (ch, from), to - from);
+            lo = jmin (lo, r.getStart());
+            hi = jmax (hi, r.getEnd());
+        }
+        drawColumn (g, x, h, lo, hi);
+    }
+    return true;
+}
+
+bool WaveformView::renderRecorder (int w, int h)
+{
+    // Scrolling view of the last snapshot window; only columns that completed since
+    // the last pass are drawn, the rest of the image is shifted left
+    const auto& rec = proc.getRecorder();
+    const int R = rec.getNumSamples();
+    const int spp = jmax (1, jmin (R, proc.getSnapshotWindowSamples()) / w);
+    const int64 total  = rec.getTotalWritten();
+    const int64 newest = total / spp;
+
+    const bool full = renderedGeneration < 0 || spp != samplesPerColumn || newest < renderedColumn; // resize, zoom or re-prepare
+    const int d = full ? w : (int) jmin ((int64) w, newest - renderedColumn);
+    if (d <= 0)
+        return false;
+
+    renderedGeneration = 0;
+    samplesPerColumn = spp;
+    if ((int) scratch.size() < spp)
+        scratch.resize ((size_t) spp);
+
+    if (d < w)
+        work.moveImageSection (0, 0, d, 0, w - d, h);
+    work.clear ({ w - d, 0, d, h });
+
+    Graphics g (work);
+    g.setColour (Colours::orange.withAlpha (0.8f));
+
+    for (int j = 0; j < d; ++j)
+    {
+        const int64 col = newest - d + j; // covers absolute samples [col * spp, (col + 1) * spp)
+        if (col < 0 || col * spp < total - R)
+            continue; // not recorded yet, or already overwritten
+
+        float lo = 0.0f, hi = 0.0f;
+        for (int ch = 0; ch < rec.getNumChannels(); ++ch)
+        {
+            rec.read (ch, (int) (((col + 1) * spp) % R), scratch.data(), spp);
+            const auto r = FloatVectorOperations::findMinAndMax (scratch.data(), spp);
+            lo = jmin (lo, r.getStart());
+            hi = jmax (hi, r.getEnd());
+        }
+        drawColumn (g, w - d + j, h, lo, hi);
+    }
+
+    renderedColumn = newest;
+    return true;
+}
+
+void WaveformView::paint (Graphics& g)
+{
+    g.fillAll (Colours::black);
+
+    Image frame;
+    {
+        const SpinLock::ScopedLockType sl (imageLock);
+        frame = image;
+    }
+    if (frame.isValid())
+        g.drawImage (frame, getLocalBounds().toFloat()); // stretched until a resize re-renders
+
+    const float w = (float) getWidth(), h = (float) getHeight();
+
+    if (snapshotView)
+    {
+        // Loop region + play-head
+        const int N = proc.getSnapshotBuffer().getNumSamples();
+        if (N > 1 && proc.isLoopingActive())
+        {
+            const float end   = (float) proc.getLoopEndPos();
+            const float start = end - (float) proc.getCurrentLoopSamples();
+            g.setColour (Colours::white.withAlpha (0.12f));
+            g.fillRect (start / N * w, 0.0f, jmax (1.0f, (end - start) / N * w), h);
+
+            g.setColour (Colours::white);
+            g.drawVerticalLine ((int) ((start + proc.getLoopReadPos()) / N * w), 0.0f, h);
+        }
+    }
+    else
+    {
+        // Where the next capture ends (latency comp + lookback), if it's on screen
+        const int window = proc.getSnapshotWindowSamples();
+        const int offset = proc.getCaptureOffsetSamples();
+        if (offset > 0 && offset < window)
+        {
+            g.setColour (Colours::yellow.withAlpha (0.7f));
+            g.drawVerticalLine ((int) (w - (float) offset / (float) window * w), 0.0f, h);
+        }
+    }
+
+    g.setColour (Colours::white.withAlpha (0.15f));
+    g.drawRect (getLocalBounds());
+}
+
+// ===================== Editor =====================
 Buffr3AudioProcessorEditor::Buffr3AudioProcessorEditor (Buffr3AudioProcessor& p)
 : AudioProcessorEditor (&p), proc (p),
   recView (p, false), snapView (p, true),
@@ -64,6 +251,17 @@ Buffr3AudioProcessorEditor::Buffr3AudioProcessorEditor (Buffr3AudioProcessor& p)
                              });
     };
 
+    // Export the loop as heard, or the raw snapshot, to a file
+    addAndMakeVisible (exportBtn);
+    exportBtn.onClick = [this]
+    {
+        juce::PopupMenu menu;
+        menu.addItem (1, "Loop (as heard)");
+        menu.addItem (2, "Raw snapshot");
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (&exportBtn),
+                            [this] (int result) { if (result != 0) launchExportChooser (result == 2); });
+    };
+
     dropHint.setText ("Drop WAV here", dontSendNotification);
     dropHint.setJustificationType (Justification::centred);
 
@@ -91,9 +289,7 @@ Buffr3AudioProcessorEditor::Buffr3AudioProcessorEditor (Buffr3AudioProcessor& p)
     pitchWheel.onValueChange = [this]
     {
         const int value = juce::jlimit (0, 16383, (int) std::lround ((pitchWheel.getValue() * 8192.0) + 8192.0));
-        auto m = juce::MidiMessage::pitchWheel (1, value);
-        m.setTimeStamp (juce::Time::getMillisecondCounterHiRes() * 0.001);
-        proc.getKeyboardCollector().addMessageToQueue (m);
+        proc.postUIEvent (UIEvent::pitchBend (value)); // if the queue is full, the next move sends a newer value
     };
     pitchWheel.onDragEnd = [this] { pitchWheel.setValue (0.0, dontSendNotification); };
 
@@ -164,6 +360,7 @@ void GlowKeysLnF::drawBlackNote (int /*midiNoteNumber*/,
 Buffr3AudioProcessorEditor::~Buffr3AudioProcessorEditor()
 {
     kbState.removeListener (kbForwarder.get());
+    kbForwarder->retryNoteOffs(); // last chance for releases still waiting for room
     keyboard.setLookAndFeel (nullptr);
     setLookAndFeel (nullptr);
 }
@@ -187,6 +384,8 @@ void Buffr3AudioProcessorEditor::filesDropped (const StringArray& files, int, in
 
 void Buffr3AudioProcessorEditor::timerCallback()
 {
+    kbForwarder->retryNoteOffs();
+
     // Show real RMS meters exposed by the processor
     meterPassVal = proc.getMeterPassthrough();
     meterLoopVal = proc.getMeterLoop();
@@ -210,6 +409,32 @@ void Buffr3AudioProcessorEditor::paint (Graphics& g)
     g.drawRect (getLocalBounds());
 }
 
+void Buffr3AudioProcessorEditor::launchExportChooser (bool rawSnapshot)
+{
+    exportChooser = std::make_unique<juce::FileChooser> (rawSnapshot ? "Export snapshot" : "Export loop", juce::File(), "*.wav;*.flac");
+    exportChooser->launchAsync (juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                  | juce::FileBrowserComponent::warnAboutOverwriting,
+                                [this, rawSnapshot] (const juce::FileChooser& fc)
+                                {
+                                    auto file = fc.getResult();
+                                    if (file == juce::File())
+                                        return;
+                                    if (! file.hasFileExtension ("wav;flac"))
+                                        file = file.withFileExtension ("wav");
+
+                                    const bool started = proc.exportAudio (file, rawSnapshot, [] (bool ok, const juce::File& f)
+                                    {
+                                        if (! ok)
+                                            juce::AlertWindow::showMessageBoxAsync (juce::AlertWindow::WarningIcon,
+                                                                                     "Export", "Could not write " + f.getFullPathName());
+                                    });
+
+                                    if (! started)
+                                        juce::AlertWindow::showMessageBoxAsync (juce::AlertWindow::WarningIcon,
+                                                                                 "Export", "An export is still running.");
+                                });
+}
+
 void Buffr3AudioProcessorEditor::resized()
 {
     auto r = getLocalBounds();
@@ -230,7 +455,9 @@ void Buffr3AudioProcessorEditor::resized()
     midiEnabled.setBounds (grid.removeFromTop (22)); grid.removeFromTop (8);
     hold.setBounds       (grid.removeFromTop (22)); grid.removeFromTop (8);
     useUser.setBounds    (grid.removeFromTop (22)); grid.removeFromTop (8);
-    loadBtn.setBounds    (grid.removeFromTop (26)); grid.removeFromTop (8);
+    auto fileRow = grid.removeFromTop (26); grid.removeFromTop (8);
+    loadBtn.setBounds    (fileRow.removeFromLeft (fileRow.getWidth() / 2));
+    exportBtn.setBounds  (fileRow.withTrimmedLeft (8));
     dropHint.setBounds   (grid.removeFromTop (18));
 
     squeeze.setBounds    (right.removeFromLeft (knobW).removeFromTop (knobH));
@@ -5,6 +5,85 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include "PluginProcessor.h"
 
+// Routes on-screen keyboard notes into the processor's UI event queue. A note-off that
+// doesn't fit is kept and re-posted (retryNoteOffs, from the editor's timer), so a full
+// queue can't leave a note held. Message thread only.
+struct KBForwarder : public juce::MidiKeyboardStateListener
+{
+    explicit KBForwarder (Buffr3AudioProcessor& p) : proc (p) {}
+
+    void handleNoteOn (juce::MidiKeyboardState*, int, int midiNoteNumber, float velocity) override
+    {
+        retryNoteOffs(); // earlier releases go first
+        proc.postUIEvent (UIEvent::noteOn (midiNoteNumber, velocity));
+    }
+
+    void handleNoteOff (juce::MidiKeyboardState*, int, int midiNoteNumber, float) override
+    {
+        retryNoteOffs();
+        if (! pendingNoteOffs.isEmpty() || ! proc.postUIEvent (UIEvent::noteOff (midiNoteNumber)))
+            pendingNoteOffs.add (midiNoteNumber);
+    }
+
+    void retryNoteOffs()
+    {
+        while (! pendingNoteOffs.isEmpty() && proc.postUIEvent (UIEvent::noteOff (pendingNoteOffs.getFirst())))
+            pendingNoteOffs.remove (0);
+    }
+
+    Buffr3AudioProcessor& proc;
+    juce::Array<int> pendingNoteOffs; // in release order
+};
+
+// One low-priority thread shared by every waveform view in the process
+struct WaveformRenderThread : public juce::TimeSliceThread
+{
+    WaveformRenderThread() : juce::TimeSliceThread ("Buffr3 waveforms") { startThread (juce::Thread::Priority::low); }
+    ~WaveformRenderThread() override                       { stopThread (2000); }
+};
+
+// Recorder (isSnapshot == false) or snapshot waveform. The waveform is rasterised into an
+// Image on the render thread, only when the data or the size changes (the recorder view
+// scrolls and draws just the new columns). paint() blits it and draws the overlays.
+class WaveformView : public juce::Component,
+                     private juce::TimeSliceClient,
+                     private juce::AsyncUpdater
+{
+public:
+    WaveformView (Buffr3AudioProcessor& p, bool isSnapshot);
+    ~WaveformView() override;
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    int  useTimeSlice() override;
+    void handleAsyncUpdate() override                      { repaint(); }
+
+    bool renderSnapshot (int w, int h);
+    bool renderRecorder (int w, int h);
+    void drawColumn (juce::Graphics& g, int x, int h, float lo, float hi) const;
+    void publish();
+
+    Buffr3AudioProcessor& proc;
+    const bool snapshotView;
+    juce::SharedResourcePointer<WaveformRenderThread> renderThread;
+
+    // Shared with the message thread
+    juce::SpinLock imageLock;
+    juce::Image image;                                     // finished frame, replaced whole
+    std::atomic<int> viewWidth { 0 }, viewHeight { 0 };
+
+    // Render thread only
+    juce::Image work;
+    std::vector<float> scratch;
+    int renderedGeneration = -1;
+    int samplesPerColumn = 1;
+    juce::int64 renderedColumn = 0;                        // recorder: newest column drawn
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformView)
+};
+
 class Buffr3AudioProcessorEditor : public juce::AudioProcessorEditor,
                                   public juce::Timer,
                                   public juce::MidiInputCallback,
@@ -36,10 +115,9 @@ public:
 private:
     Buffr3AudioProcessor& audioProcessor;
     
-    // Waveform display
-    juce::Path waveformPath;
-    juce::Path loopWaveformPath;
-    bool isLooping = false;
+    // Waveform displays (rasterised off the message thread)
+    WaveformView recView;
+    WaveformView snapView;
     
     // Components
     juce::Slider portamentoSlider;
@@ -69,6 +147,9 @@ private:
     juce::Rectangle<int> fileDropArea;
     juce::File loadedFile;
     juce::TextButton loadFileButton;
+    juce::TextButton exportBtn { "Export..." };
+    std::unique_ptr<juce::FileChooser> exportChooser;
+    void launchExportChooser (bool rawSnapshot);
     
     // MIDI keyboard
     juce::MidiKeyboardState keyboardState;
@@ -145,7 +226,6 @@ private:
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> midiDisableAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> useWavFileAttachment;
     
-    void updateWaveformDisplay();
     void loadWavFile(const juce::File& file);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Buffr3AudioProcessorEditor)
@@ -1,6 +1,6 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include <cstring> // for std::memcpy used in snapshotRecorder()
+#include "LoopKernel.h"
 
 using namespace juce;
 
@@ -22,7 +22,24 @@ AudioProcessorValueTreeState::ParameterLayout Buffr3AudioProcessor::createLayout
     params.push_back (std::make_unique<AudioParameterFloat> (param("passGain"),          "Passthrough Gain", NormalisableRange<float>(0.f, 2.0f, 0.0001f), 1.0f));
     params.push_back (std::make_unique<AudioParameterFloat> (param("mix"),               "Wet / Dry", NormalisableRange<float>(0.f, 1.0f, 0.0001f), 1.0f));
     params.push_back (std::make_unique<AudioParameterBool>  (param("useUserSample"),     "Use Loaded WAV", false));
-    params.push_back (std::make_unique<AudioParameterFloat> (param("latencyCompMs"),     "Latency Comp (ms)", NormalisableRange<float>(0.f, 200.f, 0.01f), 0.f));
+    params.push_back (std::make_unique<AudioParameterFloat> (param("latencyCompMs"),     "Latency Comp (ms)", NormalisableRange<float>(0.f, maxLatencyCompMs, 0.01f), 0.f));
+    // Buffer sizes: only applied on prepareToPlay, so hosts must not automate them
+    const auto sizing = AudioParameterIntAttributes().withAutomatable (false);
+    params.push_back (std::make_unique<AudioParameterInt>   (param("snapSlots"),         "Snapshot History", 1, maxSnapSlots, 8, sizing));
+    params.push_back (std::make_unique<AudioParameterInt>   (param("recorderSeconds"),   "Recorder Length (s)", 4, 120, 4, sizing));
+    params.push_back (std::make_unique<AudioParameterChoice>(param("recorderFormat"),    "Recorder Storage", StringArray { "32-bit float", "16-bit" }, 0,
+                                                             AudioParameterChoiceAttributes().withAutomatable (false)));
+    params.push_back (std::make_unique<AudioParameterInt>   (param("diskHistorySec"),    "Disk History (s)", 0, 600, 0, sizing)); // 0 = off
+    params.push_back (std::make_unique<AudioParameterChoice>(param("engine"),            "Engine", StringArray { "Loop", "Granular" }, 0));
+    params.push_back (std::make_unique<AudioParameterFloat> (param("grainDensity"),      "Grain Density", NormalisableRange<float>(0.25f, 128.f, 0.01f, 0.3f), 4.f));
+    params.push_back (std::make_unique<AudioParameterFloat> (param("grainJitter"),       "Grain Jitter", NormalisableRange<float>(0.f, 1.f, 0.0001f), 0.2f));
+    params.push_back (std::make_unique<AudioParameterChoice>(param("grainWindow"),       "Grain Window", StringArray { "Hann", "Gauss", "Trapezoid" }, 0));
+    params.push_back (std::make_unique<AudioParameterBool>  (param("onsetTrigger"),      "Onset Trigger", false));
+    params.push_back (std::make_unique<AudioParameterFloat> (param("onsetThresholdDb"),  "Onset Threshold (dB)", NormalisableRange<float>(3.f, 30.f, 0.01f), 12.f));
+    params.push_back (std::make_unique<AudioParameterFloat> (param("onsetLookaheadMs"),  "Onset Lookahead (ms)", NormalisableRange<float>(0.f, maxOnsetLookaheadMs, 0.01f), 10.f));
+    params.push_back (std::make_unique<AudioParameterFloat> (param("onsetGateMs"),       "Onset Gate (ms)", NormalisableRange<float>(10.f, 10000.f, 0.01f, 0.3f), 1000.f));
+    params.push_back (std::make_unique<AudioParameterChoice>(param("quality"),           "Quality", StringArray { "Auto", "Eco", "Normal", "High" }, 0));
+    params.push_back (std::make_unique<AudioParameterFloat> (param("lookbackSec"),       "Capture Lookback (s)", NormalisableRange<float>(0.f, 600.f, 0.001f, 0.4f), 0.f));
 
     return { params.begin(), params.end() };
 }
@@ -54,23 +71,102 @@ bool Buffr3AudioProcessor::isBusesLayoutSupported (const juce::AudioProcessor::B
 
 
 // ===================== Prepare / Release =====================
+// Copy into a preallocated user buffer (never reallocate). Longer sources keep their most recent (last) samples.
+static void copyUserSample (AudioBuffer<float>& dst, const AudioBuffer<float>& src)
+{
+    dst.clear();
+    const int n = std::min (src.getNumSamples(), dst.getNumSamples());
+    for (int ch = 0; ch < dst.getNumChannels(); ++ch)
+        dst.copyFrom (ch, 0, src, ch % src.getNumChannels(), src.getNumSamples() - n, n);
+}
+
 void Buffr3AudioProcessor::prepareToPlay (double sr, int samplesPerBlock)
 {
+    const ScopedLock displaySl (displayLock); // the waveform thread reads what we reallocate
+    const ScopedLock userSl (userSampleLock);  // hosts may prepare off the message thread, where samples are installed
     sampleRate = sr;
     maxSamples4s = (int) std::ceil (sampleRate * 4.0);
-    xfadeSamples = std::max (1, (int) std::round (0.003 * sampleRate)); // 3 ms seam xfade
 
-    recBuffer.setSize (std::max (1, getTotalNumInputChannels()), maxSamples4s);
-    recBuffer.clear();
-    snapBuffer.setSize (std::max (1, getTotalNumInputChannels()), maxSamples4s);
-    snapBuffer.clear();
+    const int numCh = juce::jlimit (1, maxChannels, getTotalNumInputChannels());
+    const int recSeconds = juce::jlimit (4, 120, (int) *apvts.getRawParameterValue ("recorderSeconds"));
+    const auto recFormat = (int) *apvts.getRawParameterValue ("recorderFormat") == 1 ? RecorderRing::Format::int16
+                                                                                      : RecorderRing::Format::float32;
+    diskRecorder.release(); // writer reads the ring; stop it before reallocating
+    exporter.waitForCopy(); // an export may still be copying out of the arena or a user buffer
+
+    // Headroom on top of the history so the 4 s window can always move back by the largest
+    // capture offset that isn't lookback: latency comp, onset lookahead, and the rest of the
+    // sub-block an event or onset was handled in
+    const int captureHeadroom = (int) std::ceil ((maxLatencyCompMs + maxOnsetLookaheadMs) * 0.001 * sampleRate) + maxSubBlock;
+    recorder.prepare (numCh, std::max (maxSamples4s, (int) std::ceil (sampleRate * recSeconds)) + captureHeadroom, recFormat);
+
+    if (const int diskSec = (int) *apvts.getRawParameterValue ("diskHistorySec"); diskSec > 0)
+        diskRecorder.prepare (recorder, (int) std::ceil (sampleRate * diskSec), maxSamples4s); // falls back to RAM only on failure
+
+    // Snapshot arena: all history slots live back to back in one allocation
+    numSnapSlots = juce::jlimit (1, maxSnapSlots, (int) *apvts.getRawParameterValue ("snapSlots"));
+    snapArena.setSize (numCh, maxSamples4s * (numSnapSlots + 1));
+    snapArena.clear();
+    for (int i = 0; i < maxSnapSlots; ++i)
+        snapSlots[(size_t) i] = { i * maxSamples4s, 0, 0, false };
+    spareArenaOffset = numSnapSlots * maxSamples4s;
+    newestSlot = -1;
+
+    // The audio thread is stopped: take over a published sample and work on it in place.
+    // One restored from state (no file to re-read) is converted here, before resizing.
+    swapInUserSample();
+    auto& user = userSamples[(size_t) userSampleFront];
+    const bool userRateChanged = userSampleLoaded.load() && userSampleRate > 0.0 && userSampleRate != sampleRate;
+    AudioBuffer<float> convertedUser;
+    if (userRateChanged && ! userSampleFile.existsAsFile())
+        convertedUser = SampleCache::resample (user, userSampleRate, sampleRate);
+
+    for (auto& b : userSamples)
+        b.setSize (maxChannels, maxSamples4s, true, true);
+
+    if (userRateChanged)
+    {
+        if (userSampleFile.existsAsFile())
+        {
+            requestUserSample(); // cached per (file, rate), so switching back is instant
+        }
+        else
+        {
+            copyUserSample (user, convertedUser);
+            userSampleRate = sampleRate;
+        }
+    }
 
-    recWritePos = 0;
-    snapEndPos = 0;
+    selectSnapshotSlot (0); // silent until the first capture
 
     currentLoopSamples = 1;
     pendingLoopSamples = 1;
     loopReadPos = 0.f;
+    seam = {};
+
+    grainEngine.prepare (sampleRate);
+    onsetDetector.prepare (sampleRate);
+    pendingOnsetAbs = -1;
+    onsetGateRemaining = 0;
+    captureRequestAbs = -1;
+    loopScratch.setSize (maxChannels, maxSubBlock);
+    tierScratch.setSize (maxChannels, maxSubBlock);
+
+    // Cycle cache: single-cycle loops up to 250 ms. The length is rounded up to 16 floats so every
+    // channel starts on the same alignment as the first (AudioBuffer only guarantees 16 bytes there).
+    maxCachedCycle = (int) std::ceil (0.25 * sampleRate);
+    cycleCache.audio.setSize (maxChannels, (maxCachedCycle + 15) & ~15);
+    cycleCache.recorded = 0;
+
+    // Quality: 2x oversampler for speeds above 1 (High), sized for one sub-block
+    oversampler = std::make_unique<dsp::Oversampling<float>> ((size_t) numCh, 1, dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, true);
+    oversampler->initProcessing ((size_t) maxSubBlock);
+    loopOversampled = false;
+    tierFadeSamples = std::max (1, (int) std::round (tierFadeSeconds * sampleRate));
+    tierFade.remaining = 0;
+    loadAvg = 0.0;
+    secondsSinceTierChange = 0.0;
+    applyTier (activeTier.load()); // sets the seam crossfade for this rate
 
     // Envelopes
     loopEnv.reset (sampleRate, 0.03);           // start 30 ms fade-in
@@ -81,8 +177,6 @@ void Buffr3AudioProcessor::prepareToPlay (double sr, int samplesPerBlock)
     // Portamento smoother (ms -> seconds)
     glideHz.reset (sampleRate, 0.001);
     glideHz.setCurrentAndTargetValue (440.0);
-
-    keyboardCollector.reset (sampleRate);
 }
 
 void Buffr3AudioProcessor::getStateInformation (MemoryBlock& destData)
@@ -93,17 +187,24 @@ void Buffr3AudioProcessor::getStateInformation (MemoryBlock& destData)
 
     // Save user sample if present (raw float interleaved per channel)
     MemoryBlock audioBlock;
-    if (userSampleLoaded)
+    const ScopedLock userSl (userSampleLock);
+    const bool loaded = userSampleLoaded.load();
+    if (loaded)
     {
+        const auto& user = userSamples[(size_t) userSampleLatest]; // not written again until the next load
         MemoryOutputStream aos (audioBlock, false);
-        aos.writeInt (snapBuffer.getNumChannels());
-        aos.writeInt (snapBuffer.getNumSamples());
-        for (int ch = 0; ch < snapBuffer.getNumChannels(); ++ch)
-            aos.write (snapBuffer.getReadPointer (ch), sizeof(float) * (size_t) snapBuffer.getNumSamples());
+        aos.writeInt (user.getNumChannels());
+        aos.writeInt (user.getNumSamples());
+        for (int ch = 0; ch < user.getNumChannels(); ++ch)
+            aos.write (user.getReadPointer (ch), sizeof(float) * (size_t) user.getNumSamples());
     }
-    mos.writeBool (userSampleLoaded);
+    mos.writeBool (loaded);
     mos.writeInt  ((int) audioBlock.getSize());
     mos.write (audioBlock.getData(), audioBlock.getSize());
+
+    // Where it came from + its rate, so a different session rate can reconvert it
+    mos.writeString (userSampleFile.getFullPathName());
+    mos.writeDouble (userSampleRate);
 }
 
 void Buffr3AudioProcessor::setStateInformation (const void* data, int sizeInBytes)
@@ -112,6 +213,9 @@ void Buffr3AudioProcessor::setStateInformation (const void* data, int sizeInByte
     if (auto tree = juce::ValueTree::readFromStream (mis); tree.isValid())
         apvts.replaceState (tree);
 
+    // The user sample is installed once its rate is known (below)
+    const ScopedLock userSl (userSampleLock);
+    AudioBuffer<float> restored;
     const bool hadUserSample = mis.readBool();
     const int  blobSize      = mis.readInt();
     if (hadUserSample && blobSize > 0)
@@ -121,18 +225,59 @@ void Buffr3AudioProcessor::setStateInformation (const void* data, int sizeInByte
         MemoryInputStream aos (tmp.getData(), (size_t) blobSize, false);
         const int ch   = aos.readInt();
         const int nSam = aos.readInt();
-        snapBuffer.setSize (std::max (1, ch), std::min (nSam, maxSamples4s));
-        for (int c = 0; c < snapBuffer.getNumChannels(); ++c)
-            mis.read (snapBuffer.getWritePointer (c),
-                     static_cast<size_t>(sizeof(float) * blobSize));
-        userSampleLoaded = true;
+        if (ch > 0 && nSam > 0)
+        {
+            restored.setSize (std::min (ch, maxChannels), nSam);
+            restored.clear();
+            for (int c = 0; c < ch; ++c)
+            {
+                if (c < restored.getNumChannels())
+                    aos.read (restored.getWritePointer (c), (int) sizeof(float) * nSam);
+                else
+                    aos.skipNextBytes ((int64) sizeof(float) * nSam);
+            }
+        }
     }
+
+    // Older states end here
+    userSampleFile = File();
+    userSampleRate = 0.0;
+    if (! mis.isExhausted())
+    {
+        const auto path = mis.readString();
+        userSampleRate  = mis.readDouble();
+        if (File::isAbsolutePath (path))
+            userSampleFile = File (path);
+    }
+
+    if (restored.getNumSamples() > 0)
+    {
+        // With no file to re-read, a sample stored at another rate is converted here; prepareToPlay
+        // only covers states restored before it. Mono states are copied to all channels.
+        if (! userSampleFile.existsAsFile() && userSampleRate > 0.0 && userSampleRate != sampleRate && getSampleRate() > 0.0)
+        {
+            restored = SampleCache::resample (restored, userSampleRate, sampleRate);
+            userSampleRate = sampleRate;
+        }
+
+        // Fill the user buffer that isn't playing, then hand it to the audio thread
+        copyUserSample (beginUserSampleWrite(), restored);
+        publishUserSample();
+    }
+
+    if (userSampleLoaded && userSampleFile.existsAsFile() && userSampleRate != sampleRate)
+        requestUserSample();
 }
 
 // ===================== WAV loading =====================
 void Buffr3AudioProcessor::clearUserSample()
 {
+    const ScopedLock sl (userSampleLock);
     userSampleLoaded = false;
+    if (userSamplePending.exchange (-1) >= 0) // not swapped in yet: drop it, the front is the newest again
+        userSampleLatest = 1 - userSampleLatest;
+    userSampleFile = File();
+    ++userLoadSerial; // ignore a conversion still in flight
 }
 
 void Buffr3AudioProcessor::loadWavFile (const File& file, String& error)
@@ -146,21 +291,64 @@ void Buffr3AudioProcessor::loadWavFile (const File& file, String& error)
         return;
     }
 
-    const double lengthSec = (double) reader->lengthInSamples / reader->sampleRate;
-    const int    targetSamples = std::min (maxSamples4s, (int) std::ceil (sampleRate * 4.0));
+    // Decoding + sample rate conversion happen on the cache's worker thread
+    const ScopedLock sl (userSampleLock);
+    userSampleFile = file;
+    requestUserSample();
+}
 
-    AudioBuffer<float> tmp ((int) reader->numChannels, targetSamples);
-    tmp.clear();
+void Buffr3AudioProcessor::requestUserSample()
+{
+    // Last 4 s of the file at the session rate, cropped/padded like a snapshot
+    const ScopedLock sl (userSampleLock);
+    const int serial = ++userLoadSerial;
+    const double rate = sampleRate;
+    WeakReference<Buffr3AudioProcessor> weakThis (this);
 
-    // Read up to 4 seconds, crop if longer, pad with silence if shorter
-    const int toRead = std::min ((int) reader->lengthInSamples, targetSamples);
-    reader->read (&tmp, 0, toRead, (int64) std::max<int64> (0, reader->lengthInSamples - toRead), true, true);
+    sampleCache->request (userSampleFile, rate, maxSamples4s, [weakThis, serial, rate] (SampleCache::Buffer converted)
+    {
+        if (auto* self = weakThis.get(); self != nullptr && converted != nullptr)
+            self->installUserSample (*converted, rate, serial);
+    });
+}
 
-    // If the source sr != session sr, JUCE reader already resamples only if it's an AudioTransportSource;
-    // so here we just copy raw, it's fine for a snapshot source content.
-    snapBuffer = tmp;
-    snapEndPos = snapBuffer.getNumSamples();
+void Buffr3AudioProcessor::installUserSample (const AudioBuffer<float>& src, double rate, int serial)
+{
+    const ScopedLock sl (userSampleLock);
+    if (serial != userLoadSerial || src.getNumChannels() == 0)
+        return;
+
+    // A prepare at another rate landed while this was converting: convert again for the new one
+    if (rate != sampleRate)
+    {
+        requestUserSample();
+        return;
+    }
+
+    copyUserSample (beginUserSampleWrite(), src);
+    userSampleRate = rate;
+    publishUserSample();
+}
+
+AudioBuffer<float>& Buffr3AudioProcessor::beginUserSampleWrite()
+{
+    // Take back a sample the audio thread hasn't swapped in yet. Otherwise it has (or is about
+    // to), so the other buffer is the one it stopped playing.
+    const int reclaimed = userSamplePending.exchange (-1);
+    userSampleLatest = reclaimed >= 0 ? reclaimed : 1 - userSampleLatest;
+
+    // An export may still be copying it out from before the swap
+    auto& user = userSamples[(size_t) userSampleLatest];
+    if (exporter.getPinned() == user.getReadPointer (0))
+        exporter.waitForCopy();
+
+    return user;
+}
+
+void Buffr3AudioProcessor::publishUserSample()
+{
     userSampleLoaded = true;
+    userSamplePending = userSampleLatest; // picked up at the start of the next block
 }
 
 // ===================== Process =====================
@@ -168,99 +356,219 @@ void Buffr3AudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer&
 {
     const ScopedNoDenormals _noDenormals;
     const int numSamples = buffer.getNumSamples();
-    const int numCh = std::min (buffer.getNumChannels(), recBuffer.getNumChannels());
+    const auto startTicks = Time::getHighResolutionTicks(); // for the Auto quality tier
+
+    // UI events apply at the start of the block
+    drainUIEvents();
+    diskRecorder.setCaptureOffset (getCaptureOffsetSamples()); // keeps the disk window prefetched
+
+    // Work in sub-blocks of at most maxSubBlock samples so scratch, input and snapshot
+    // reads stay cache-resident whatever the host block size. Sub-blocks also split at
+    // MIDI events, so triggers and captures land on the event's sample.
+    float passSq = 0.0f, loopSq = 0.0f;
+    auto event = midi.cbegin();
+    int pos = 0;
+    while (pos < numSamples)
+    {
+        for (; event != midi.cend() && (*event).samplePosition <= pos; ++event)
+            handleMidiMessage ((*event).getMessage());
+
+        int end = std::min (numSamples, pos + maxSubBlock);
+        if (event != midi.cend())
+            end = std::min (end, (*event).samplePosition);
+
+        processSubBlock (buffer, pos, end - pos, passSq, loopSq);
+        pos = end;
+    }
+    for (; event != midi.cend(); ++event) // stray events past the end
+        handleMidiMessage ((*event).getMessage());
+
+    // Meters (RMS over the whole block, channel 0)
+    meterPassthrough = numSamples > 0 ? std::sqrt (passSq / (float) numSamples) : 0.0f;
+    meterLoop        = numSamples > 0 ? std::sqrt (loopSq / (float) numSamples) : 0.0f;
+
+    // We are an effect; ensure we don't pass MIDI downstream
+    midi.clear();
+
+    updateAutoTier ((double) numSamples / sampleRate,
+                    Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks));
+}
+
+// Sum of squares over every stride-th sample, scaled back to the full count (Eco meters)
+static float sumOfSquares (const float* x, int numSamples, int stride)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < numSamples; i += stride)
+        sum += x[i] * x[i];
+    return sum * (float) stride;
+}
+
+void Buffr3AudioProcessor::processSubBlock (AudioBuffer<float>& buffer, int startSample, int numSamples,
+                                            float& passSq, float& loopSq)
+{
+    const int numCh = std::min (buffer.getNumChannels(), recorder.getNumChannels());
 
-    // Merge UI keyboard MIDI into midi buffer (no MIDI out)
-    MidiBuffer uiMidi;
-    keyboardCollector.removeNextBlockOfMessages (uiMidi, numSamples);
-    for (const auto meta : uiMidi) midi.addEvent (meta.getMessage(), meta.samplePosition);
+    // Views into the host buffer and the preallocated scratch (no allocation)
+    AudioBuffer<float> io (buffer.getArrayOfWritePointers(), numCh, startSample, numSamples);
+    AudioBuffer<float> loopOut (loopScratch.getArrayOfWritePointers(), numCh, 0, numSamples);
 
-    // Always write input into the 4s recorder (before we mute passthrough)
-    writeToRecorder (buffer);
+    // Always write input into the recorder (before we mute passthrough)
+    writeToRecorder (io);
 
-    // Handle incoming MIDI & compute pending loop settings
-    handleMidi (midi, numSamples);
+    // Compute pending loop settings (and start/stop) for this sub-block
     computePendingLoopFromControls (numSamples);
 
+    // Quality tier for this sub-block (Auto follows the load measured in processBlock)
+    const int quality = (int) *apvts.getRawParameterValue ("quality");
+    targetTier = quality == 0 ? autoTier : quality - 1;
+
     // Synthesize loop and mix/mute passthrough
-    AudioBuffer<float> loopOut (numCh, numSamples);
     loopOut.clear();
     if (looping.load())
         advanceLoopPlayback (loopOut, numSamples);
+    if (activeTier.load() != targetTier && tierFade.remaining == 0)
+        applyTier (targetTier); // nothing audible to fade (not looping, or granular)
 
-    // Passthrough muting envelope (30ms fade out on loop start, release on stop)
-    mixPassthrough (buffer, numSamples);
-
-    // Compose wet/dry:
-    const float loopGain  = *apvts.getRawParameterValue ("loopGain");
-    const float passGain  = *apvts.getRawParameterValue ("passGain");
-    const float mix       = *apvts.getRawParameterValue ("mix");
-
-    // Wet = (muted-passthrough) + loop
-    for (int ch = 0; ch < numCh; ++ch)
+    // Passthrough mute (30ms fade out on loop start, release on stop) + wet/dry
+    switch (BUFFR3_GENERIC_DSP ? 0 : numCh)
     {
-        auto* dry  = buffer.getReadPointer (ch);
-        auto* wet  = buffer.getWritePointer (ch);
-        auto* loop = loopOut.getReadPointer (ch);
-
-        for (int i = 0; i < numSamples; ++i)
-        {
-            const float wetSig  = (wet[i] * passGain) + (loop[i] * loopGain * loopEnv.getNextValue());
-            const float out     = dry[i] * (1.0f - mix) + wetSig * mix;
-            wet[i] = out;
-        }
+        case 1:  mixSubBlock<1> (io, loopOut, numSamples); break;
+        case 2:  mixSubBlock<2> (io, loopOut, numSamples); break;
+        default: mixSubBlock<0> (io, loopOut, numSamples); break;
     }
 
-    // Meters (RMS)
-    meterPassthrough = buffer.getRMSLevel (0, 0, numSamples);
-    meterLoop        = loopOut.getRMSLevel (0, 0, numSamples);
-
-    // We are an effect; ensure we don't pass MIDI downstream
-    midi.clear();
+    const int meterStride = activeTier.load() == tierEco ? 4 : 1;
+    passSq += sumOfSquares (io.getReadPointer (0), numSamples, meterStride);
+    loopSq += sumOfSquares (loopOut.getReadPointer (0), numSamples, meterStride);
 }
 
 void Buffr3AudioProcessor::writeToRecorder (const AudioBuffer<float>& in)
 {
-    const int numCh = std::min (recBuffer.getNumChannels(), in.getNumChannels());
-    const int n = in.getNumSamples();
+    const auto startAbs = recorder.getTotalWritten();
+
+    // Channel-major contiguous runs; the ring encodes to 16-bit with SIMD when enabled
+    recorder.write (in, 0, in.getNumSamples());
 
-    int w = recWritePos.load();
-    for (int i = 0; i < n; ++i)
+    // Onset detection rides along on the same audio; the capture itself waits for the lookahead
+    if (*apvts.getRawParameterValue ("onsetTrigger") > 0.5f)
     {
-        for (int ch = 0; ch < numCh; ++ch)
-            recBuffer.getWritePointer (ch)[w] = in.getReadPointer (ch)[i];
+        onsetDetector.setThresholdDb (*apvts.getRawParameterValue ("onsetThresholdDb"));
 
-        if (++w >= recBuffer.getNumSamples()) w = 0;
+        juce::int64 onset = 0;
+        if (onsetDetector.process (in.getArrayOfReadPointers(), in.getNumChannels(), in.getNumSamples(), startAbs, onset)
+             && pendingOnsetAbs < 0)
+            pendingOnsetAbs = onset;
+    }
+    else
+    {
+        pendingOnsetAbs = -1;
+        onsetGateRemaining = 0;
     }
-    recWritePos.store (w);
 }
 
 void Buffr3AudioProcessor::snapshotRecorder (int latencyCompSamples)
 {
-    // Copy the entire 4s ring to a linear snapshot so content is frozen for the loop
-    const int N = recBuffer.getNumSamples();
-    const int numCh = recBuffer.getNumChannels();
+    // Decode the most recent 4 s of the ring into the next history slot so content is frozen for the loop
+    const int N = maxSamples4s;
+    const int R = recorder.getNumSamples();
+    const int numCh = std::min (recorder.getNumChannels(), snapArena.getNumChannels());
 
-    snapBuffer.setSize (numCh, N, false, false, true);
+    // Overwrite the oldest slot; older captures stay recallable until the ring wraps
+    const int slot = (newestSlot + 1) % numSnapSlots;
+    auto& info = snapSlots[(size_t) slot];
 
-    // End should be the "most recent" audio, latency compensated
-    int end = recWritePos.load() - latencyCompSamples;
-    while (end < 0) end += N;
-    end %= N;
+    // An export may still be copying this slot: leave it alone and capture into the spare region
+    if (snapArena.getReadPointer (0, info.arenaOffset) == exporter.getPinned())
+        std::swap (info.arenaOffset, spareArenaOffset);
 
-    // Copy [0..end) and [end..N) into linear snap
-    const int tail = N - end;
+    // End should be the "most recent" audio, latency compensated
+    float* chans[maxChannels] {};
     for (int ch = 0; ch < numCh; ++ch)
-    {
-        auto* dst = snapBuffer.getWritePointer (ch);
-        const float* src = recBuffer.getReadPointer (ch);
-        std::memcpy (dst,            src + end, sizeof(float) * (size_t) tail);
-        std::memcpy (dst + tail,     src,       sizeof(float) * (size_t) end);
-    }
-    snapEndPos = N; // end of linear buffer
+        chans[ch] = snapArena.getWritePointer (ch, info.arenaOffset);
+
+    // Older than the RAM ring holds: take it from the disk recorder's prefetched window.
+    // Never blocks; if nothing is staged yet we fall back to the oldest audio in RAM.
+    const bool fromDisk = diskRecorder.needsDisk (latencyCompSamples)
+                       && diskRecorder.readWindow (recorder.getTotalWritten() - latencyCompSamples, chans, numCh, N);
+
+    int end = recorder.getWritePos() - std::min (latencyCompSamples, R - N);
+    while (end < 0) end += R;
+    end %= R;
+
+    // Linear [end-N..end) of the ring into the slot (the ring handles wrap + decode)
+    if (! fromDisk)
+        for (int ch = 0; ch < numCh; ++ch)
+            recorder.read (ch, end, chans[ch], N);
+    info.length = N;
+    info.valid = true;
+    newestSlot = slot;
+
+    selectSnapshotSlot (slot);
     loopReadPos = (float) (currentLoopSamples - 1); // begin on end boundary for clean first loop
 }
 
+int Buffr3AudioProcessor::getCaptureOffsetSamples (int sinceSamples) const
+{
+    const float latencyMs  = *apvts.getRawParameterValue ("latencyCompMs");
+    const float lookbackSec = *apvts.getRawParameterValue ("lookbackSec");
+    const int offset = (int) std::round ((latencyMs / 1000.0f + lookbackSec) * sampleRate) + sinceSamples;
+
+    // The whole 4 s window must still be inside the recorder's history (RAM, or disk when longer)
+    const int history = std::max (recorder.getNumSamples(), diskRecorder.getHistorySamples());
+    return juce::jlimit (0, std::max (0, history - maxSamples4s), offset);
+}
+
+void Buffr3AudioProcessor::recallSnapshot (int age)
+{
+    if (newestSlot < 0 || age < 0 || age >= numSnapSlots)
+        return;
+
+    const int slot = (newestSlot - age + numSnapSlots) % numSnapSlots;
+    if (snapSlots[(size_t) slot].valid)
+        selectSnapshotSlot (slot); // loop keeps its phase; content switches on the next sample
+}
+
+void Buffr3AudioProcessor::selectSnapshotSlot (int slot)
+{
+    // O(1), no copy or allocation: point snapBuffer at the slot's region of the arena
+    const auto& info = snapSlots[(size_t) slot];
+    const int numCh = snapArena.getNumChannels();
+
+    float* chans[maxChannels] {};
+    for (int ch = 0; ch < numCh; ++ch)
+        chans[ch] = snapArena.getWritePointer (ch, info.arenaOffset);
+
+    snapBuffer.setDataToReferTo (chans, numCh, std::max (1, info.length));
+    snapEndPos = snapBuffer.getNumSamples(); // end of linear buffer
+    ++snapshotGeneration;
+}
+
+void Buffr3AudioProcessor::selectUserSample()
+{
+    auto& user = userSamples[(size_t) userSampleFront];
+    snapBuffer.setDataToReferTo (user.getArrayOfWritePointers(), user.getNumChannels(), user.getNumSamples());
+    snapEndPos = snapBuffer.getNumSamples();
+    ++snapshotGeneration;
+}
+
+void Buffr3AudioProcessor::swapInUserSample()
+{
+    const int next = userSamplePending.exchange (-1);
+    if (next < 0)
+        return;
+
+    // The message thread writes the next sample into the retired buffer, so snapBuffer must leave it
+    const bool wasPlaying = snapBuffer.getNumChannels() > 0
+                         && snapBuffer.getReadPointer (0) == userSamples[(size_t) userSampleFront].getReadPointer (0);
+    userSampleFront = next;
+
+    // A fresh sample takes over right away if it's the active source
+    if (wasPlaying || (looping.load() && *apvts.getRawParameterValue ("useUserSample") > 0.5f))
+        selectUserSample();
+    else
+        ++snapshotGeneration; // content may be on screen already
+}
+
 void Buffr3AudioProcessor::computePendingLoopFromControls (int numSamples)
 {
     const bool midiEnabled   = *apvts.getRawParameterValue ("midiEnabled") > 0.5f;
@@ -299,16 +607,41 @@ void Buffr3AudioProcessor::computePendingLoopFromControls (int numSamples)
     // The 'pending' loop length is based on the *current* smoothed value, sampled at loop end
     pendingLoopSamples = targetSamples;
 
-    // Start/stop logic: if Hold or notesDown>0, looping; else release
+    // A note-on was handled before this sub-block's input went into the recorder: end its
+    // capture on the event's sample, not on the end of the sub-block
+    int  captureOffset = getCaptureOffsetSamples (captureRequestAbs >= 0 ? (int) (recorder.getTotalWritten() - captureRequestAbs) : 0);
+
+    // Audio onset: once its lookahead is recorded, capture ending exactly there (no latency
+    // compensation needed, the audio is the trigger) and gate the loop on for onsetGateMs
+    bool onsetFired = false;
+    if (pendingOnsetAbs >= 0)
+    {
+        const auto lookahead  = (juce::int64) std::round (*apvts.getRawParameterValue ("onsetLookaheadMs") * 0.001 * sampleRate);
+        const auto captureEnd = pendingOnsetAbs + lookahead;
+        const auto written    = recorder.getTotalWritten();
+        if (written >= captureEnd)
+        {
+            onsetFired = true;
+            captureOffset = (int) (written - captureEnd);
+            onsetGateRemaining = (int) std::round (*apvts.getRawParameterValue ("onsetGateMs") * 0.001 * sampleRate);
+            pendingOnsetAbs = -1;
+        }
+    }
+    if (! onsetFired)
+        onsetGateRemaining = std::max (0, onsetGateRemaining - numSamples);
+
+    const bool gate = hold || notesDown > 0 || onsetGateRemaining > 0;
+
+    // Start/stop logic: if Hold, notesDown>0 or a recent onset, looping; else release
     const int relMs = (int) *apvts.getRawParameterValue ("releaseMs");
-    if ((hold || notesDown > 0) && ! looping.load())
+    if (gate && ! looping.load())
     {
-        // trigger: snapshot (respect latency comp and WAV toggle)
-        const int latencySamples = (int) std::round ((*apvts.getRawParameterValue ("latencyCompMs") / 1000.0f) * sampleRate);
+        // trigger: snapshot (respect latency comp, lookback and WAV toggle)
+        const int latencySamples = captureOffset;
         if (useUserSample && userSampleLoaded)
         {
-            // Use existing snapBuffer content as snapshot (already set by loadWavFile)
-            snapEndPos = snapBuffer.getNumSamples();
+            // Use the loaded WAV as snapshot (filled by loadWavFile / setStateInformation)
+            selectUserSample();
         }
         else
         {
@@ -317,6 +650,7 @@ void Buffr3AudioProcessor::computePendingLoopFromControls (int numSamples)
 
         currentLoopSamples = std::max (1, pendingLoopSamples);
         loopReadPos = (float) (currentLoopSamples - 1);
+        grainEngine.reset();
         looping.store (true);
 
         loopEnv.reset (sampleRate, 0.03);
@@ -326,7 +660,16 @@ void Buffr3AudioProcessor::computePendingLoopFromControls (int numSamples)
         passthroughMuteEnv.reset (sampleRate, 0.03); // 30 ms mute
         passthroughMuteEnv.setTargetValue (0.f);
     }
-    else if (!hold && notesDown == 0 && looping.load())
+    else if ((onsetFired || captureRequestAbs >= 0) && looping.load())
+    {
+        // Re-capture on each note-on or hit: unless HOLD pins the content or a WAV is the source
+        if (! hold && ! useUserSample)
+            snapshotRecorder (captureOffset);
+
+        loopEnv.setTargetValue (1.f);
+        passthroughMuteEnv.setTargetValue (0.f);
+    }
+    else if (! gate && looping.load())
     {
         // start release; looping will be stopped at envelope end (checked in advanceLoopPlayback)
         loopEnv.reset (sampleRate, std::max (0.001, (double) relMs / 1000.0));
@@ -335,6 +678,9 @@ void Buffr3AudioProcessor::computePendingLoopFromControls (int numSamples)
         passthroughMuteEnv.reset (sampleRate, std::max (0.001, (double) relMs / 1000.0));
         passthroughMuteEnv.setTargetValue (1.f);
     }
+
+    // Whichever branch ran took the capture (or the trigger already did): one per trigger
+    captureRequestAbs = -1;
 }
 
 void Buffr3AudioProcessor::advanceLoopPlayback (AudioBuffer<float>& out, int numSamples)
@@ -346,62 +692,81 @@ void Buffr3AudioProcessor::advanceLoopPlayback (AudioBuffer<float>& out, int num
     if (N <= 1 || currentLoopSamples <= 0)
         return;
 
-    for (int i = 0; i < numSamples; ++i)
+    if ((int) *apvts.getRawParameterValue ("engine") == 1)
     {
-        // Seamless loop with short crossfade at end -> start
-        const int start = snapEndPos - currentLoopSamples; // loop start within snapshot
-        const int s = juce::jlimit (0, N-1, start);
-
-        const float pos = loopReadPos;
-        const int ip = (int) pos;
-        const float frac = pos - ip;
-
-        // Base read index within [start, snapEndPos)
-        int idx0 = s + ip;
-        int idx1 = s + ip + 1;
-        if (idx0 >= snapEndPos) idx0 -= currentLoopSamples;
-        if (idx1 >= snapEndPos) idx1 -= currentLoopSamples;
-
-        const int samplesLeft = currentLoopSamples - 1 - ip;
-
-        // Crossfade if near end
-        float xfadeA = 1.0f, xfadeB = 0.0f;
-        if (samplesLeft < xfadeSamples)
+        // Granular: no loop edge to wait for, grains follow the pending period directly
+        currentLoopSamples = std::max (1, pendingLoopSamples);
+        tierFade.remaining = 0;
+
+        GrainEngine::Settings gs;
+        gs.periodSamples = currentLoopSamples;
+        gs.density = *apvts.getRawParameterValue ("grainDensity");
+        gs.jitter  = *apvts.getRawParameterValue ("grainJitter");
+        gs.speed   = speed;
+        gs.window  = (GrainEngine::Window) (int) *apvts.getRawParameterValue ("grainWindow");
+        grainEngine.process (snapBuffer, snapEndPos, out, numSamples, gs);
+    }
+    else
+    {
+        // New content (capture, recall, sample swap) or a length set outside the loop edge
+        // (e.g. coming back from the granular engine): pick the seam right away
+        if (seam.generation != snapshotGeneration.load() || seam.length != currentLoopSamples || seam.end > snapEndPos)
+            optimizeSeam();
+
+        // A tier (or oversampling) change forks the playback state: the outgoing tier keeps
+        // rendering from its copy while the output fades over to the new one, so
+        // interpolation, seam and filter switches don't click. Further changes wait for it.
+        const bool oversample = targetTier == tierHigh && speed > 1.0f;
+        if (tierFade.remaining == 0 && (targetTier != activeTier.load() || oversample != loopOversampled))
         {
-            const float t = juce::jlimit (0.0f, 1.0f, (float) samplesLeft / (float) std::max (1, xfadeSamples));
-            xfadeA = t;
-            xfadeB = 1.0f - t;
+            tierFade = { loopReadPos, currentLoopSamples, seam, activeTier.load(), loopOversampled, tierFadeSamples };
+            cycleCache.recorded = 0;
+            applyTier (targetTier);
+            if (oversample && ! loopOversampled)
+                oversampler->reset(); // only one side of a fade is ever oversampled
+            loopOversampled = oversample;
         }
 
-        for (int ch = 0; ch < numCh; ++ch)
+        if (tierFade.remaining > 0)
         {
-            const float* src = snapBuffer.getReadPointer (ch);
-            const float a0 = src[idx0];
-            const float a1 = src[idx1];
-            const float sampA = a0 + frac * (a1 - a0);
-
-            // Pre-read from start for crossfade-in
-            int cidx0 = s + (ip + 1 - currentLoopSamples);
-            int cidx1 = s + (ip + 2 - currentLoopSamples);
-            while (cidx0 < 0) cidx0 += N;
-            while (cidx1 < 0) cidx1 += N;
-            if (cidx0 >= N) cidx0 -= N;
-            if (cidx1 >= N) cidx1 -= N;
-
-            const float b0 = src[cidx0];
-            const float b1 = src[cidx1];
-            const float sampB = b0 + frac * (b1 - b0);
-
-            out.getWritePointer (ch)[i] = sampA * xfadeA + sampB * xfadeB;
-        }
+            AudioBuffer<float> previous (tierScratch.getArrayOfWritePointers(), numCh, 0, numSamples);
+            previous.clear();
+            renderOutgoingTier (previous, numSamples, speed);
+            renderLoopTier (out, numSamples, speed, activeTier.load(), loopOversampled);
 
-        // advance
-        loopReadPos += speed;
-        if (loopReadPos >= (float) currentLoopSamples)
+            const int faded = tierFadeSamples - tierFade.remaining;
+            for (int ch = 0; ch < numCh; ++ch)
+            {
+                auto* o = out.getWritePointer (ch);
+                auto* p = previous.getReadPointer (ch);
+                for (int i = 0; i < numSamples; ++i)
+                    o[i] = p[i] + std::min (1.0f, (float) (faded + i + 1) / (float) tierFadeSamples) * (o[i] - p[i]);
+            }
+            tierFade.remaining = std::max (0, tierFade.remaining - numSamples);
+        }
+        else
         {
-            // At loop end: quantise update to pending length
-            currentLoopSamples = std::max (1, pendingLoopSamples);
-            loopReadPos -= (float) currentLoopSamples;
+            // Unity speed from a whole-sample position: the output only depends on the loop
+            // position, so a fully recorded cycle can be replayed as long as nothing changes
+            const bool cacheable = speed == 1.0f && ! loopOversampled && currentLoopSamples <= maxCachedCycle
+                                && loopReadPos == std::floor (loopReadPos);
+
+            if (cacheable && pendingLoopSamples == currentLoopSamples && cycleCache.key == seam
+                && cycleCache.recorded >= currentLoopSamples && cycleCache.nextPos == (int) loopReadPos)
+            {
+                playCycle (out, numSamples);
+            }
+            else
+            {
+                const int  startPos  = (int) loopReadPos;
+                const Seam startSeam = seam;
+                renderLoopTier (out, numSamples, speed, activeTier.load(), loopOversampled);
+
+                if (cacheable && seam == startSeam)
+                    recordCycle (out, startPos, numSamples);
+                else
+                    cycleCache.recorded = 0;
+            }
         }
     }
 
@@ -410,64 +775,409 @@ void Buffr3AudioProcessor::advanceLoopPlayback (AudioBuffer<float>& out, int num
     {
         looping.store (false);
         loopReadPos = 0.0f;
+        grainEngine.reset();
+        tierFade.remaining = 0;
     }
 }
 
-void Buffr3AudioProcessor::mixPassthrough (AudioBuffer<float>& inout, int numSamples)
+void Buffr3AudioProcessor::renderOutgoingTier (AudioBuffer<float>& out, int numSamples, float speed)
 {
-    const int numCh = inout.getNumChannels();
+    // Swap the outgoing copy of the loop state in, advance it, and swap it back out
+    std::swap (loopReadPos, tierFade.readPos);
+    std::swap (currentLoopSamples, tierFade.loopSamples);
+    std::swap (seam, tierFade.seam);
 
-    // passthroughMuteEnv == 1 => full passthrough, 0 => muted
-    for (int ch = 0; ch < numCh; ++ch)
+    renderLoopTier (out, numSamples, speed, tierFade.tier, tierFade.oversampled);
+
+    std::swap (loopReadPos, tierFade.readPos);
+    std::swap (currentLoopSamples, tierFade.loopSamples);
+    std::swap (seam, tierFade.seam);
+}
+
+void Buffr3AudioProcessor::renderLoopTier (AudioBuffer<float>& out, int numSamples, float speed, int tier, bool oversampled)
+{
+    const bool cubic = tier == tierHigh;
+
+    if (! oversampled || oversampler == nullptr)
     {
-        auto* p = inout.getWritePointer (ch);
-        for (int i = 0; i < numSamples; ++i)
-            p[i] *= juce::jlimit (0.0f, 1.0f, passthroughMuteEnv.getNextValue());
+        cubic ? renderLoopVariant<true> (out, numSamples, speed) : renderLoopVariant<false> (out, numSamples, speed);
+        return;
     }
+
+    // 2x: render at half speed into the upsampled block, then band-limit on the way down
+    dsp::AudioBlock<float> block (out.getArrayOfWritePointers(), (size_t) out.getNumChannels(), (size_t) numSamples);
+    auto up = oversampler->processSamplesUp (block);
+
+    float* upChans[maxChannels] {};
+    for (size_t ch = 0; ch < up.getNumChannels(); ++ch)
+        upChans[ch] = up.getChannelPointer (ch);
+    AudioBuffer<float> upView (upChans, (int) up.getNumChannels(), (int) up.getNumSamples());
+
+    cubic ? renderLoopVariant<true> (upView, upView.getNumSamples(), speed * 0.5f)
+          : renderLoopVariant<false> (upView, upView.getNumSamples(), speed * 0.5f);
+
+    oversampler->processSamplesDown (block);
 }
 
-void Buffr3AudioProcessor::handleMidi (MidiBuffer& midi, int /*numSamples*/)
+template <bool Cubic>
+void Buffr3AudioProcessor::renderLoopVariant (AudioBuffer<float>& out, int numSamples, float speed)
 {
-    const bool midiEnabled    = *apvts.getRawParameterValue ("midiEnabled") > 0.5f;
-    const bool holdParam      = *apvts.getRawParameterValue ("hold") > 0.5f;
-    const bool useUserSample  = *apvts.getRawParameterValue ("useUserSample") > 0.5f;
-    const int  latencySamples = (int) std::round ((*apvts.getRawParameterValue ("latencyCompMs") / 1000.0f) * sampleRate);
+    // Runs that cannot reach the seam skip the crossfade and wrap handling
+    const bool seamFree = ! BUFFR3_GENERIC_DSP
+                       && loopReadPos + speed * (float) numSamples < (float) (currentLoopSamples - seam.xfade - 2);
+    switch (BUFFR3_GENERIC_DSP ? 0 : std::min (out.getNumChannels(), snapBuffer.getNumChannels()))
+    {
+        case 1:  seamFree ? renderLoop<1, false, Cubic> (out, numSamples, speed) : renderLoop<1, true, Cubic> (out, numSamples, speed); break;
+        case 2:  seamFree ? renderLoop<2, false, Cubic> (out, numSamples, speed) : renderLoop<2, true, Cubic> (out, numSamples, speed); break;
+        default: seamFree ? renderLoop<0, false, Cubic> (out, numSamples, speed) : renderLoop<0, true, Cubic> (out, numSamples, speed); break;
+    }
+}
+
+// Single-cycle loop, rendered by LoopKernel (shared with the exporter). NumCh > 0 fixes the
+// channel count at compile time; Seam = false is only used when the whole run stays clear of
+// the crossfade zone and the loop edge. Cubic selects Hermite over linear interpolation (High tier).
+template <int NumCh, bool Seam, bool Cubic>
+void Buffr3AudioProcessor::renderLoop (AudioBuffer<float>& out, int numSamples, float speed)
+{
+    const int numCh = NumCh > 0 ? NumCh : std::min (out.getNumChannels(), snapBuffer.getNumChannels());
+    const int N = snapBuffer.getNumSamples();
+    jassert (numCh <= maxChannels);
+    static_assert (maxChannels <= LoopKernel::maxChannels);
 
-    for (const auto meta : midi)
+    auto currentLoop = [&]
     {
-        const auto m = meta.getMessage();
+        const int L = currentLoopSamples;
+        return LoopKernel::Loop { juce::jlimit (0, N - 1, seam.end - L), L, seam.xfade, N };
+    };
 
-        if (m.isNoteOn())
-        {
-            notesDown = std::max (0, notesDown + 1);
-            if (midiEnabled)
-                lastNoteNumber = m.getNoteNumber();
+    auto loop = currentLoop();
+    float* dst[maxChannels] {};
 
-            // Snapshot on every note-on unless HOLD is intentionally pinning content,
-            // or we're using a user-loaded WAV instead of the live recorder.
-            if (!holdParam && !useUserSample)
-                snapshotRecorder (latencySamples);
+    // The kernel returns at each loop end, where the pending length is picked up
+    for (int done = 0; done < numSamples;)
+    {
+        for (int ch = 0; ch < numCh; ++ch)
+            dst[ch] = out.getWritePointer (ch, done);
 
-            // If we were in release, go back to full loop quickly
-            if (looping.load())
-            {
-                loopEnv.setTargetValue (1.f);
-                passthroughMuteEnv.setTargetValue (0.f);
-            }
+        done += LoopKernel::render<NumCh, Seam, Cubic> (snapBuffer.getArrayOfReadPointers(), dst, numCh,
+                                                        numSamples - done, loop, loopReadPos, speed);
+
+        if (loopReadPos >= (float) loop.length)
+        {
+            // At loop end: quantise update to pending length (and re-seam if it changed)
+            currentLoopSamples = std::max (1, pendingLoopSamples);
+            loopReadPos -= (float) currentLoopSamples;
+            if (speed == 1.0f)
+                loopReadPos = std::floor (loopReadPos); // sub-sample phase at the seam: lets the cycle cache engage
+            if (currentLoopSamples != seam.length)
+                optimizeSeam();
+
+            loop = currentLoop();
         }
-        else if (m.isNoteOff())
+    }
+}
+
+// ===================== Cycle cache =====================
+void Buffr3AudioProcessor::recordCycle (const AudioBuffer<float>& out, int startPos, int numSamples)
+{
+    const int L = seam.length;
+    if (cycleCache.key != seam || cycleCache.nextPos != startPos)
+    {
+        cycleCache.key = seam; // something changed (or playback jumped): start over from here
+        cycleCache.recorded = 0;
+    }
+
+    int pos = startPos, done = 0;
+    while (done < numSamples)
+    {
+        const int n = std::min (numSamples - done, L - pos);
+        for (int ch = 0; ch < out.getNumChannels(); ++ch)
+            cycleCache.audio.copyFrom (ch, pos, out, ch, done, n);
+
+        done += n;
+        pos += n;
+        if (pos >= L) pos = 0;
+    }
+
+    cycleCache.nextPos = pos;
+    cycleCache.recorded = std::min (L, cycleCache.recorded + numSamples);
+}
+
+void Buffr3AudioProcessor::playCycle (AudioBuffer<float>& out, int numSamples)
+{
+    const int L = currentLoopSamples;
+    int pos = (int) loopReadPos, done = 0;
+    while (done < numSamples)
+    {
+        const int n = std::min (numSamples - done, L - pos);
+        for (int ch = 0; ch < out.getNumChannels(); ++ch)
+            out.copyFrom (ch, done, cycleCache.audio, ch, pos, n);
+
+        done += n;
+        pos += n;
+        if (pos >= L) pos = 0;
+    }
+
+    loopReadPos = (float) pos;
+    cycleCache.nextPos = pos;
+}
+
+// ===================== Quality tiers =====================
+void Buffr3AudioProcessor::applyTier (int tier)
+{
+    // Seam crossfade per tier: Eco 1 ms, Normal 3 ms, High 6 ms
+    static constexpr double xfadeMs[] = { 1.0, 3.0, 6.0 };
+
+    tier = juce::jlimit ((int) tierEco, (int) tierHigh, tier);
+    activeTier.store (tier);
+    xfadeSamples = std::max (1, (int) std::round (xfadeMs[tier] * 0.001 * sampleRate));
+    seam.xfade = seamCrossfade (seam.score, seam.length);
+}
+
+// ===================== Seam search =====================
+// Sums a.b, a.a and b.b over n samples; four independent lanes so it vectorises
+static void correlate (const float* a, const float* b, int n, float& ab, float& aa, float& bb)
+{
+    float sab[4] = {}, saa[4] = {}, sbb[4] = {};
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        for (int l = 0; l < 4; ++l)
         {
-            notesDown = std::max (0, notesDown - 1);
+            sab[l] += a[i + l] * b[i + l];
+            saa[l] += a[i + l] * a[i + l];
+            sbb[l] += b[i + l] * b[i + l];
         }
-        else if (m.isPitchWheel())
+    }
+    for (; i < n; ++i)
+    {
+        sab[0] += a[i] * b[i];
+        saa[0] += a[i] * a[i];
+        sbb[0] += b[i] * b[i];
+    }
+
+    ab += (sab[0] + sab[1]) + (sab[2] + sab[3]);
+    aa += (saa[0] + saa[1]) + (saa[2] + saa[3]);
+    bb += (sbb[0] + sbb[1]) + (sbb[2] + sbb[3]);
+}
+
+// The wrap plays x[end-1] then x[end-L]; it is seamless when the audio around the start
+// matches the audio around the end. Try up to seamRange loop ends (newest first, same
+// length so pitch is unchanged) and keep the one whose two windows, centred on the join,
+// differ least relative to their energy. The window needs a few samples past the end, so
+// the loop ends seamWindow/2 samples before the newest audio. Cost per call is bounded by
+// seamRange * seamWindow * channels.
+void Buffr3AudioProcessor::optimizeSeam()
+{
+    const int L = std::max (1, currentLoopSamples);
+    const int numCh = snapBuffer.getNumChannels();
+
+    seam.end = snapEndPos;
+    seam.length = L;
+    seam.generation = snapshotGeneration.load();
+    seam.score = 0.0f;
+
+    const int w = std::min (seamWindow, L / 2) & ~1; // even: the window ends exactly at snapEndPos
+    const int h = w / 2;
+    const int range = std::min ({ seamRange, L, snapEndPos - L - w + 1 });
+    if (w >= 4 && range > 0)
+    {
+        float best = -2.0f;
+        for (int end = snapEndPos - h; end > snapEndPos - h - range; --end)
         {
-            const int val = m.getPitchWheelValue(); // 0..16383
-            const float norm = (val - 8192) / 8192.0f; // -1..+1
-            pitchBendNorm.store (juce::jlimit (-1.0f, 1.0f, norm));
+            float ab = 0.0f, aa = 0.0f, bb = 0.0f;
+            for (int ch = 0; ch < numCh; ++ch)
+            {
+                const float* a = snapBuffer.getReadPointer (ch) + end - h;
+                correlate (a, a - L, w, ab, aa, bb);
+            }
+
+            // 1 - |a-b|^2 / (|a|^2 + |b|^2): 1 for identical windows, unlike plain
+            // normalised correlation it also penalises level differences
+            const float score = 2.0f * ab / (aa + bb + 1.0e-12f);
+            if (score > best + 1.0e-4f) // ties keep the newer end
+            {
+                best = score;
+                seam.end = end;
+            }
         }
+        seam.score = best;
+    }
+
+    seam.xfade = seamCrossfade (seam.score, L);
+}
+
+// Crossfade only as much as the seam needs: none when the windows (nearly) match, the tier's
+// full length when they don't correlate; never more than half the loop
+int Buffr3AudioProcessor::seamCrossfade (float score, int loopSamples) const
+{
+    if (score > 0.99f)
+        return 0;
+
+    const float need = juce::jlimit (0.0f, 1.0f, 1.0f - score);
+    return std::min (std::max (1, loopSamples / 2), (int) std::ceil ((float) xfadeSamples * need));
+}
+
+// Auto: step down when the smoothed processing time nears the block deadline, back up
+// after a longer stretch with plenty of headroom
+void Buffr3AudioProcessor::updateAutoTier (double blockSeconds, double elapsedSeconds)
+{
+    static constexpr double downgradeLoad = 0.6, upgradeLoad = 0.25;
+    static constexpr double downgradeHoldSeconds = 0.25, maxUpgradeHoldSeconds = 32.0;
+
+    if (blockSeconds <= 0.0)
+        return;
+
+    loadAvg += (elapsedSeconds / blockSeconds - loadAvg) * 0.1;
+    secondsSinceTierChange += blockSeconds;
+
+    if (loadAvg > downgradeLoad && autoTier > tierEco && secondsSinceTierChange > downgradeHoldSeconds)
+    {
+        --autoTier;
+        secondsSinceTierChange = 0.0;
+        upgradeHoldSeconds = std::min (maxUpgradeHoldSeconds, upgradeHoldSeconds * 2.0);
+    }
+    else if (loadAvg < upgradeLoad && autoTier < tierHigh && secondsSinceTierChange > upgradeHoldSeconds)
+    {
+        ++autoTier;
+        secondsSinceTierChange = 0.0;
+    }
+}
+
+// NumCh > 0 fixes the channel count at compile time (0 = use the buffer's)
+template <int NumCh>
+void Buffr3AudioProcessor::mixSubBlock (AudioBuffer<float>& inout, const AudioBuffer<float>& loopOut, int numSamples)
+{
+    const int numCh = NumCh > 0 ? NumCh : inout.getNumChannels();
+
+    const float loopGain  = *apvts.getRawParameterValue ("loopGain");
+    const float passGain  = *apvts.getRawParameterValue ("passGain");
+    const float mix       = *apvts.getRawParameterValue ("mix");
+
+    // Envelopes step once per sample, shared by all channels
+    // (passthroughMuteEnv == 1 => full passthrough, 0 => muted)
+    for (int i = 0; i < numSamples; ++i)
+    {
+        passGainScratch[(size_t) i] = juce::jlimit (0.0f, 1.0f, passthroughMuteEnv.getNextValue());
+        loopGainScratch[(size_t) i] = loopEnv.getNextValue();
+    }
+
+    // out = dry * (1 - mix) + (dry * passGain + loop * loopGain * env) * mix, dry = muted passthrough
+    const float dryScale  = (1.0f - mix) + passGain * mix;
+    const float loopScale = loopGain * mix;
+
+    for (int ch = 0; ch < numCh; ++ch)
+    {
+        auto* io = inout.getWritePointer (ch);
+        auto* loop = loopOut.getReadPointer (ch);
+
+        for (int i = 0; i < numSamples; ++i)
+            io[i] = io[i] * passGainScratch[(size_t) i] * dryScale + loop[i] * loopGainScratch[(size_t) i] * loopScale;
+    }
+}
+
+void Buffr3AudioProcessor::handleMidiMessage (const MidiMessage& m)
+{
+    if (m.isNoteOn())
+    {
+        handleNoteOn (m.getNoteNumber());
+    }
+    else if (m.isNoteOff())
+    {
+        handleNoteOff();
+    }
+    else if (m.isProgramChange())
+    {
+        // Program N recalls the Nth most recent capture (0 = newest)
+        recallSnapshot (m.getProgramChangeNumber());
+    }
+    else if (m.isPitchWheel())
+    {
+        handlePitchWheel (m.getPitchWheelValue());
     }
     // We clear MIDI later in processBlock (no MIDI out).
 }
 
+void Buffr3AudioProcessor::drainUIEvents()
+{
+    // Wait-free: the message thread never holds anything we could block on.
+    // A user sample is handed over through its own atomic, so it can't be lost to a full queue.
+    swapInUserSample();
+
+    UIEvent e;
+    while (uiEvents.pop (e))
+    {
+        switch (e.type)
+        {
+            case UIEvent::Type::noteOn:     handleNoteOn (e.value); break;
+            case UIEvent::Type::noteOff:    handleNoteOff(); break;
+            case UIEvent::Type::pitchBend:  handlePitchWheel (e.value); break;
+            case UIEvent::Type::exportAudio: submitExport (e.value != 0); break;
+        }
+    }
+}
+
+bool Buffr3AudioProcessor::exportAudio (const File& file, bool rawSnapshot, LoopExporter::Callback onDone)
+{
+    if (! exporter.begin (file, std::move (onDone)))
+        return false;
+
+    postUIEvent (UIEvent::exportAudio (rawSnapshot)); // if dropped, the exporter times out and reports failure
+    return true;
+}
+
+void Buffr3AudioProcessor::submitExport (bool rawSnapshot)
+{
+    // Only a reference to what is playing goes out; the exporter renders and writes on its own thread
+    LoopExporter::Job job;
+    job.numChannels = std::min (snapBuffer.getNumChannels(), maxChannels);
+    for (int ch = 0; ch < job.numChannels; ++ch)
+        job.channels[ch] = snapBuffer.getReadPointer (ch);
+
+    job.length       = rawSnapshot ? snapEndPos : std::min (seam.end, snapEndPos);
+    job.loopSamples  = rawSnapshot ? 0 : std::max (1, looping.load() ? currentLoopSamples : pendingLoopSamples);
+    job.xfadeSamples = seam.xfade;
+    job.cubic        = activeTier.load() == tierHigh;
+    job.oversampled  = loopOversampled;
+    job.speed        = *apvts.getRawParameterValue ("playbackSpeed");
+    job.sampleRate   = sampleRate;
+    exporter.submit (job);
+}
+
+void Buffr3AudioProcessor::handleNoteOn (int noteNumber)
+{
+    const bool midiEnabled    = *apvts.getRawParameterValue ("midiEnabled") > 0.5f;
+    const bool holdParam      = *apvts.getRawParameterValue ("hold") > 0.5f;
+    const bool useUserSample  = *apvts.getRawParameterValue ("useUserSample") > 0.5f;
+
+    notesDown = std::max (0, notesDown + 1);
+    if (midiEnabled)
+        lastNoteNumber = noteNumber;
+
+    // Snapshot on every note-on unless HOLD is intentionally pinning content,
+    // or we're using a user-loaded WAV instead of the live recorder. The capture itself
+    // happens once, in computePendingLoopFromControls, which may also be starting the loop.
+    if (!holdParam && !useUserSample)
+        captureRequestAbs = recorder.getTotalWritten();
+
+    // If we were in release, go back to full loop quickly
+    if (looping.load())
+    {
+        loopEnv.setTargetValue (1.f);
+        passthroughMuteEnv.setTargetValue (0.f);
+    }
+}
+
+void Buffr3AudioProcessor::handleNoteOff()
+{
+    notesDown = std::max (0, notesDown - 1);
+}
+
+void Buffr3AudioProcessor::handlePitchWheel (int value14)
+{
+    const float norm = (value14 - 8192) / 8192.0f; // 0..16383 -> -1..+1
+    pitchBendNorm.store (juce::jlimit (-1.0f, 1.0f, norm));
+}
+
 // ===================== Editor factory =====================
 AudioProcessorEditor* Buffr3AudioProcessor::createEditor() { return new Buffr3AudioProcessorEditor (*this); }
@@ -3,6 +3,24 @@
 #include <juce_audio_utils/juce_audio_utils.h>
 #include <juce_audio_formats/juce_audio_formats.h>
 #include <juce_dsp/juce_dsp.h>
+#include "RecorderRing.h"
+#include "DiskRecorder.h"
+#include "SampleCache.h"
+#include "GrainEngine.h"
+#include "UIEventQueue.h"
+#include "LoopExporter.h"
+#include "OnsetDetector.h"
+
+// Longest internal sub-block; host blocks are processed in chunks of at most this
+#ifndef BUFFR3_MAX_SUBBLOCK
+ #define BUFFR3_MAX_SUBBLOCK 256
+#endif
+
+// Benchmarks only: 1 routes every sub-block through the generic (any channel count, seam
+// handling) loop and mix variants, to measure what the specialisations save
+#ifndef BUFFR3_GENERIC_DSP
+ #define BUFFR3_GENERIC_DSP 0
+#endif
 
 
 class Buffr3AudioProcessor : public juce::AudioProcessor
@@ -28,7 +46,7 @@ public:
 
     // Lifecycle
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void releaseResources() override                       {}
+    void releaseResources() override                       { diskRecorder.release(); }
 
     // Audio + MIDI
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
@@ -54,34 +72,73 @@ public:
     float getLoopEnv() const                               { return loopEnv.getCurrentValue(); }
     float getPassthroughEnv() const                        { return 1.0f - passthroughMuteEnv.getCurrentValue(); }
 
-    const juce::AudioBuffer<float>& getRecordBuffer() const { return recBuffer; } // continuous recorder (4s)
-    const juce::AudioBuffer<float>& getSnapshotBuffer() const { return snapBuffer; } // frozen at trigger
-    int  getRecorderWritePos() const                       { return recWritePos.load(); }
+    const RecorderRing& getRecorder() const                { return recorder; } // continuous recorder (recorderSeconds)
+    const juce::AudioBuffer<float>& getSnapshotBuffer() const { return snapBuffer; } // frozen at trigger (view into arena)
+    int  getRecorderWritePos() const                       { return recorder.getWritePos(); }
     int  getSnapshotEndPos() const                         { return snapEndPos; } // end is "most recent" in snapshot
+    int  getLoopEndPos() const                             { return seam.end; }   // loop plays [end - length, end), <= snapshot end
+    int  getSnapshotGeneration() const                     { return snapshotGeneration.load(); } // bumps when snapshot content changes
+    int  getSnapshotWindowSamples() const                  { return maxSamples4s; }
+    const juce::CriticalSection& getDisplayLock() const    { return displayLock; } // held while prepareToPlay reallocates the above
+    int  getCurrentLoopSamples() const                     { return currentLoopSamples; }
+    float getLoopReadPos() const                           { return loopReadPos; }
+    int  getCaptureOffsetSamples (int sinceSamples = 0) const; // latency comp + lookback (+ audio recorded since), clamped to history
     float getMeterPassthrough() const { return meterPassthrough; }
     float getMeterLoop() const { return meterLoop; }
 
+    // Quality tiers: interpolation order, seam length, 2x anti-aliasing above unity speed, meter precision
+    enum Tier { tierEco = 0, tierNormal, tierHigh };
+    int getActiveTier() const { return activeTier.load(); }
+
     // WAV handling
-    bool hasUserSample() const                             { return userSampleLoaded; }
+    bool hasUserSample() const                             { return userSampleLoaded.load(); }
     void clearUserSample();
-    void loadWavFile (const juce::File& file, juce::String& error);
+    void loadWavFile (const juce::File& file, juce::String& error); // converted asynchronously to the session rate
 
-    // On-screen keyboard MIDI (UI->DSP)
-    juce::MidiMessageCollector& getKeyboardCollector()     { return keyboardCollector; }
+    // On-screen keyboard / wheel (UI->DSP), message thread only. False if the queue is full.
+    bool postUIEvent (const UIEvent& e)                    { return uiEvents.push (e); }
+
+    // Message thread: write the loop as heard (or the raw snapshot) to a WAV/FLAC file in
+    // the background. False if an export is still running.
+    bool exportAudio (const juce::File& file, bool rawSnapshot, LoopExporter::Callback onDone);
 
 private:
     // ===== Parameter layout =====
     static APVTS::ParameterLayout createLayout();
 
     // ===== Core engine =====
+    void processSubBlock (juce::AudioBuffer<float>& buffer, int startSample, int numSamples, float& passSq, float& loopSq);
     void writeToRecorder (const juce::AudioBuffer<float>& in);
     void snapshotRecorder (int latencyCompSamples);
+    void recallSnapshot (int age);                         // 0 = newest capture, 1 = one before, ...
+    void selectSnapshotSlot (int slot);
+    void selectUserSample();
+    void swapInUserSample();
+    void requestUserSample();
+    void installUserSample (const juce::AudioBuffer<float>& src, double rate, int serial);
+    juce::AudioBuffer<float>& beginUserSampleWrite();
+    void publishUserSample();
     void computePendingLoopFromControls (int numSamples);
     void advanceLoopPlayback (juce::AudioBuffer<float>& out, int numSamples);
-    void mixPassthrough (juce::AudioBuffer<float>& inout, int numSamples);
+    void renderLoopTier (juce::AudioBuffer<float>& out, int numSamples, float speed, int tier, bool oversampled);
+    void renderOutgoingTier (juce::AudioBuffer<float>& out, int numSamples, float speed);
+    template <bool Cubic> void renderLoopVariant (juce::AudioBuffer<float>& out, int numSamples, float speed);
+    template <int NumCh, bool Seam, bool Cubic> void renderLoop (juce::AudioBuffer<float>& out, int numSamples, float speed);
+    void applyTier (int tier);
+    void optimizeSeam();
+    void recordCycle (const juce::AudioBuffer<float>& out, int startPos, int numSamples);
+    void playCycle (juce::AudioBuffer<float>& out, int numSamples);
+    int  seamCrossfade (float score, int loopSamples) const;
+    void updateAutoTier (double blockSeconds, double elapsedSeconds);
+    template <int NumCh> void mixSubBlock (juce::AudioBuffer<float>& inout, const juce::AudioBuffer<float>& loopOut, int numSamples);
 
     // MIDI helpers
-    void handleMidi (juce::MidiBuffer& midi, int numSamples);
+    void handleMidiMessage (const juce::MidiMessage& m);
+    void drainUIEvents();
+    void submitExport (bool rawSnapshot);
+    void handleNoteOn (int noteNumber);
+    void handleNoteOff();
+    void handlePitchWheel (int value14);
     static double midiNoteToHz (int midiNote)              { return 440.0 * std::pow (2.0, (midiNote - 69) / 12.0); }
     static double semitoneShiftToRatio (double semis)      { return std::pow (2.0, semis / 12.0); }
 
@@ -98,21 +155,94 @@ private:
     // ===== State =====
     APVTS apvts { *this, nullptr, "PARAMS", createLayout() };
 
-    // Recorder (always running, 4 s)
-    juce::AudioBuffer<float> recBuffer;
-    std::atomic<int> recWritePos { 0 };
+    // Recorder (always running, recorderSeconds long, float or 16-bit storage)
+    RecorderRing recorder;
+    DiskRecorder diskRecorder; // optional spill of older history to a mapped file (diskHistorySec)
+
+    // Snapshot history: a ring of 4 s slots in one arena allocated in prepareToPlay.
+    // snapBuffer never owns memory, it only refers to the active slot (or the user sample),
+    // so switching between captures is a pointer swap. Slots hold decoded copies rather than
+    // offsets into the recorder: the ring may store 16-bit or spill to disk, and it overwrites
+    // itself within seconds, so an offset would go stale long before the slot is recalled.
+    static constexpr int maxChannels = 2;
+    static constexpr int maxSnapSlots = 32;
+    static constexpr float maxLatencyCompMs = 200.0f;    // parameter ranges, also size the recorder headroom
+    static constexpr float maxOnsetLookaheadMs = 200.0f;
+
+    struct SnapSlot
+    {
+        int  arenaOffset = 0;  // first sample of the slot within snapArena
+        int  length = 0;       // valid samples in the slot
+        bool valid = false;
+    };
+
+    juce::AudioBuffer<float> snapArena;
+    std::array<SnapSlot, maxSnapSlots> snapSlots {};
+    int   numSnapSlots = 8;
+    int   newestSlot = -1;     // most recent capture, -1 when history is empty
+    int   spareArenaOffset = 0; // extra region, swapped in when the next slot is pinned by an export
 
-    // Snapshot taken at trigger
     juce::AudioBuffer<float> snapBuffer;
     int   snapEndPos = 0;  // "most recent" end within snapshot
-    bool  userSampleLoaded = false; // if true, snapshot copies from user sample instead of recorder
+    std::atomic<int> snapshotGeneration { 0 };
+
+    // User WAV, kept outside the history ring so captures never overwrite it. Two preallocated
+    // buffers: the message thread fills the one not playing and publishes it, the audio thread
+    // swaps it in at the start of a block.
+    std::array<juce::AudioBuffer<float>, 2> userSamples { juce::AudioBuffer<float> (maxChannels, 44100 * 4),
+                                                          juce::AudioBuffer<float> (maxChannels, 44100 * 4) };
+    int   userSampleFront = 0;                    // audio thread: the buffer snapBuffer may refer to
+    std::atomic<int>  userSamplePending { -1 };   // published buffer not swapped in yet, -1 if none
+    std::atomic<bool> userSampleLoaded { false }; // if true, snapshot copies from user sample instead of recorder
+
+    LoopExporter exporter;
+
+    // User WAV conversion. The message thread installs samples; prepareToPlay, which hosts
+    // may call from another thread, resizes and converts them. Both hold userSampleLock.
+    juce::SharedResourcePointer<SampleCache> sampleCache; // shared by every instance in the process
+    juce::CriticalSection userSampleLock;
+    juce::File userSampleFile;     // where the user sample came from, if a file
+    double userSampleRate = 0.0;   // rate the user sample is stored at (0 = unknown, assume session rate)
+    int    userSampleLatest = 0;   // buffer holding the newest published sample
+    int    userLoadSerial = 0;     // drops conversions that finish after a newer load
 
     // Loop playback
     std::atomic<bool> looping { false };
     int   currentLoopSamples = 1;   // strictly > 0
     int   pendingLoopSamples = 1;   // sampled at loop end
     float loopReadPos = 0.0f;       // [0, currentLoopSamples)
-    int   xfadeSamples = 0;
+    int   xfadeSamples = 0;    // longest seam crossfade (quality tier)
+
+    // Seam search (audio thread): loop end with the best continuity for the current length
+    struct Seam
+    {
+        int   end = 0;             // loop is [end - length, end) within the snapshot
+        int   length = 0;
+        int   xfade = 0;           // crossfade actually used, <= xfadeSamples
+        float score = 0.0f;        // normalised correlation at the seam
+        int   generation = -1;     // snapshot it was computed for
+
+        bool operator== (const Seam& o) const { return end == o.end && length == o.length && xfade == o.xfade && generation == o.generation; }
+        bool operator!= (const Seam& o) const { return ! operator== (o); }
+    };
+    Seam seam;
+
+    // One cycle of a settled loop (unity speed, same length, seam and snapshot), recorded as
+    // it plays; once complete, playback copies from it instead of re-rendering the cycle
+    struct CycleCache
+    {
+        juce::AudioBuffer<float> audio;    // maxChannels x maxCachedCycle, sized in prepareToPlay
+        Seam  key;                         // seam (so length and snapshot) it was recorded with
+        int   nextPos = 0;                 // loop position of the next sample
+        int   recorded = 0;                // consecutive samples recorded, complete at key.length
+    };
+    CycleCache cycleCache;
+    int maxCachedCycle = 0;                // longer loops are always rendered
+    static constexpr int seamWindow = 16;  // comparison window centred on the join (samples)
+    static constexpr int seamRange  = 256; // candidate loop ends, newest first
+
+    // Granular playback (engine == Granular), reads snapBuffer like the loop
+    GrainEngine grainEngine;
 
     // Envelopes
     juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> loopEnv;           // loop gain env (start fast, release param)
@@ -124,17 +254,59 @@ private:
     std::atomic<float> pitchBendNorm { 0.0f }; // [-1, 1], UI or incoming MIDI maps here
     int notesDown = 0;
     int lastNoteNumber = 60;
+    juce::int64 captureRequestAbs = -1; // recorder position of a note-on wanting a capture, -1 if none
+
+    // UI -> processor events (preallocated, wait-free SPSC)
+    SpscQueue<UIEvent, 256> uiEvents;
 
-    // UI keyboard -> processor MIDI
-    juce::MidiMessageCollector keyboardCollector;
+    // Audio-triggered capture
+    OnsetDetector onsetDetector;
+    juce::int64 pendingOnsetAbs = -1; // onset waiting for its lookahead to be recorded
+    int onsetGateRemaining = 0;       // samples the loop stays gated on after an onset
 
     // Meters
     float meterPassthrough = 0.0f;
     float meterLoop = 0.0f;
 
+    // Sub-block scratch (loop output), sized once in prepareToPlay
+    static constexpr int maxSubBlock = BUFFR3_MAX_SUBBLOCK;
+    juce::AudioBuffer<float> loopScratch;
+    std::array<float, maxSubBlock> passGainScratch {}, loopGainScratch {}; // per-sample envelope gains
+
+    // Quality tiers (audio thread; activeTier is read by the UI)
+    std::unique_ptr<juce::dsp::Oversampling<float>> oversampler;
+    juce::AudioBuffer<float> tierScratch;       // previous tier's output while fading to a new one
+    std::atomic<int> activeTier { tierNormal };
+    int    targetTier = tierNormal;
+    bool   loopOversampled = false;
+    int    autoTier = tierNormal;
+    double loadAvg = 0.0;                       // smoothed processBlock time / block duration
+    double secondsSinceTierChange = 0.0;
+    double upgradeHoldSeconds = 2.0;            // grows after each downgrade so Auto doesn't flap
+
+    // Tier change crossfade: the outgoing tier keeps playing from its own copy of the loop
+    // state for tierFadeSeconds, however many sub-blocks that spans
+    struct TierFade
+    {
+        float readPos = 0.0f;
+        int   loopSamples = 1;
+        Seam  seam;
+        int   tier = tierNormal;
+        bool  oversampled = false;
+        int   remaining = 0;                    // samples left, 0 when no fade is running
+    };
+    TierFade tierFade;
+    int tierFadeSamples = 1;
+    static constexpr double tierFadeSeconds = 0.005;
+
+    // Taken by prepareToPlay and by display threads reading the recorder, arena or user sample
+    // (never by the audio thread), so a re-prepare can't free buffers mid-read
+    juce::CriticalSection displayLock;
+
     // Runtime
     double sampleRate = 44100.0;
-    int    maxSamples4s = 44100 * 4;
+    int    maxSamples4s = 44100 * 4;   // snapshot window
 
+    JUCE_DECLARE_WEAK_REFERENCEABLE (Buffr3AudioProcessor)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Buffr3AudioProcessor)
 };
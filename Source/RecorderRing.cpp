@@ -0,0 +1,170 @@
+#include "RecorderRing.h"
+#include <cstring>
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+using namespace juce;
+
+static constexpr float int16Scale    = 32767.0f;
+static constexpr float int16InvScale = 1.0f / 32767.0f;
+
+#if JUCE_USE_ARM_NEON && ! JUCE_USE_SSE_INTRINSICS
+// Float -> int32 rounding to nearest, like cvtps and the scalar tail (vcvtq truncates)
+static inline int32x4_t roundToInt32 (float32x4_t x) noexcept
+{
+   #if defined (__aarch64__) || defined (_M_ARM64)
+    return vcvtnq_s32_f32 (x);
+   #else
+    // ARMv7 has no rounding convert: add 0.5 carrying the sign of x, then truncate
+    const uint32x4_t sign = vandq_u32 (vreinterpretq_u32_f32 (x), vdupq_n_u32 (0x80000000u));
+    const float32x4_t half = vreinterpretq_f32_u32 (vorrq_u32 (vreinterpretq_u32_f32 (vdupq_n_f32 (0.5f)), sign));
+    return vcvtq_s32_f32 (vaddq_f32 (x, half));
+   #endif
+}
+#endif
+
+// ===================== Codec =====================
+void RecorderRing::encodeInt16 (const float* src, int16_t* dst, int num) noexcept
+{
+    int i = 0;
+
+   #if JUCE_USE_SSE_INTRINSICS
+    const __m128 scale = _mm_set1_ps (int16Scale);
+    for (; i + 8 <= num; i += 8)
+    {
+        // cvtps rounds to nearest, packs saturates anything outside [-1, 1]
+        const __m128i lo = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (src + i),     scale));
+        const __m128i hi = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (src + i + 4), scale));
+        _mm_storeu_si128 ((__m128i*) (dst + i), _mm_packs_epi32 (lo, hi));
+    }
+   #elif JUCE_USE_ARM_NEON
+    const float32x4_t scale = vdupq_n_f32 (int16Scale);
+    for (; i + 8 <= num; i += 8)
+    {
+        // qmovn saturates anything outside [-1, 1]
+        const int32x4_t lo = roundToInt32 (vmulq_f32 (vld1q_f32 (src + i),     scale));
+        const int32x4_t hi = roundToInt32 (vmulq_f32 (vld1q_f32 (src + i + 4), scale));
+        vst1q_s16 (dst + i, vcombine_s16 (vqmovn_s32 (lo), vqmovn_s32 (hi)));
+    }
+   #endif
+
+    for (; i < num; ++i)
+        dst[i] = (int16_t) roundToInt (jlimit (-1.0f, 1.0f, src[i]) * int16Scale);
+}
+
+void RecorderRing::decodeInt16 (const int16_t* src, float* dst, int num) noexcept
+{
+    int i = 0;
+
+   #if JUCE_USE_SSE_INTRINSICS
+    const __m128 scale = _mm_set1_ps (int16InvScale);
+    for (; i + 8 <= num; i += 8)
+    {
+        const __m128i v  = _mm_loadu_si128 ((const __m128i*) (src + i));
+        const __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16); // sign-extend
+        const __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+        _mm_storeu_ps (dst + i,     _mm_mul_ps (_mm_cvtepi32_ps (lo), scale));
+        _mm_storeu_ps (dst + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), scale));
+    }
+   #elif JUCE_USE_ARM_NEON
+    const float32x4_t scale = vdupq_n_f32 (int16InvScale);
+    for (; i + 8 <= num; i += 8)
+    {
+        const int16x8_t v = vld1q_s16 (src + i);
+        vst1q_f32 (dst + i,     vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16  (v))), scale));
+        vst1q_f32 (dst + i + 4, vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (v))), scale));
+    }
+   #endif
+
+    for (; i < num; ++i)
+        dst[i] = (float) src[i] * int16InvScale;
+}
+
+// ===================== Ring =====================
+void RecorderRing::prepare (int numChannels, int numSamples, Format newFormat)
+{
+    format   = newFormat;
+    channels = std::max (1, numChannels);
+    size     = std::max (1, numSamples);
+
+    const auto total = (size_t) channels * (size_t) size;
+    if (format == Format::int16)
+    {
+        intData.allocate (total, true);
+        floatData.free();
+    }
+    else
+    {
+        floatData.allocate (total, true);
+        intData.free();
+    }
+
+    writePos = 0;
+    totalWritten = 0;
+}
+
+void RecorderRing::writeSegment (int channel, const float* src, int ringPos, int num) noexcept
+{
+    const auto offset = (size_t) channel * (size_t) size + (size_t) ringPos;
+    if (format == Format::int16)
+        encodeInt16 (src, intData + offset, num);
+    else
+        std::memcpy (floatData + offset, src, sizeof (float) * (size_t) num);
+}
+
+void RecorderRing::readSegment (int channel, int ringPos, float* dst, int num) const noexcept
+{
+    const auto offset = (size_t) channel * (size_t) size + (size_t) ringPos;
+    if (format == Format::int16)
+        decodeInt16 (intData + offset, dst, num);
+    else
+        std::memcpy (dst, floatData + offset, sizeof (float) * (size_t) num);
+}
+
+void RecorderRing::readRaw (int channel, int ringPos, void* dest, int num) const noexcept
+{
+    jassert (ringPos + num <= size);
+    const auto offset = (size_t) channel * (size_t) size + (size_t) ringPos;
+    if (format == Format::int16)
+        std::memcpy (dest, intData + offset, sizeof (int16_t) * (size_t) num);
+    else
+        std::memcpy (dest, floatData + offset, sizeof (float) * (size_t) num);
+}
+
+void RecorderRing::write (const AudioBuffer<float>& in, int startSample, int numSamples)
+{
+    const int numCh = std::min (channels, in.getNumChannels());
+    int w = writePos.load();
+
+    // Split at the wrap point so each channel is encoded as at most two contiguous runs
+    int done = 0;
+    while (done < numSamples)
+    {
+        const int run = std::min (numSamples - done, size - w);
+        for (int ch = 0; ch < numCh; ++ch)
+            writeSegment (ch, in.getReadPointer (ch, startSample + done), w, run);
+
+        done += run;
+        w += run;
+        if (w >= size) w = 0;
+    }
+    writePos.store (w);
+    totalWritten.fetch_add (numSamples, std::memory_order_release);
+}
+
+void RecorderRing::read (int channel, int endPos, float* dest, int numSamples) const
+{
+    jassert (numSamples <= size);
+    int start = endPos - numSamples;
+    while (start < 0) start += size;
+    start %= size;
+
+    const int first = std::min (numSamples, size - start);
+    readSegment (channel, start, dest, first);
+    if (first < numSamples)
+        readSegment (channel, 0, dest + first, numSamples - first);
+}
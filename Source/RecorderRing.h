@@ -0,0 +1,48 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+
+// Always-running input recorder. Stores the ring either as 32-bit float or as
+// 16-bit integer (half the memory and bandwidth, fine for loop material).
+// Encode/decode run on whole contiguous runs so the SIMD paths get long spans.
+class RecorderRing
+{
+public:
+    enum class Format { float32 = 0, int16 };
+
+    // Allocates; call from prepareToPlay only
+    void prepare (int numChannels, int numSamples, Format format);
+
+    // Audio thread: append numSamples from 'in' starting at startSample, wrapping at the end
+    void write (const juce::AudioBuffer<float>& in, int startSample, int numSamples);
+
+    // Decode numSamples of 'channel' ending just before ring index 'endPos' into dest (linear)
+    void read (int channel, int endPos, float* dest, int numSamples) const;
+
+    // Copy num encoded samples starting at ring index ringPos (no wrap) as raw bytes
+    void readRaw (int channel, int ringPos, void* dest, int num) const noexcept;
+
+    int    getWritePos() const                 { return writePos.load(); }
+    int64_t getTotalWritten() const            { return totalWritten.load (std::memory_order_acquire); } // since prepare
+    int    getNumSamples() const               { return size; }
+    int    getNumChannels() const              { return channels; }
+    Format getFormat() const                   { return format; }
+    size_t getBytesPerSample() const           { return format == Format::int16 ? sizeof (int16_t) : sizeof (float); }
+
+    // Codec, exposed for anything else storing recorder-format audio
+    static void encodeInt16 (const float* src, int16_t* dst, int num) noexcept;
+    static void decodeInt16 (const int16_t* src, float* dst, int num) noexcept;
+
+private:
+    void writeSegment (int channel, const float* src, int ringPos, int num) noexcept;
+    void readSegment  (int channel, int ringPos, float* dst, int num) const noexcept;
+
+    juce::HeapBlock<float>   floatData;   // channels * size, used for Format::float32
+    juce::HeapBlock<int16_t> intData;     // channels * size, used for Format::int16
+    Format format = Format::float32;
+    int    channels = 0;
+    int    size = 0;
+    std::atomic<int> writePos { 0 };
+    std::atomic<int64_t> totalWritten { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (RecorderRing)
+};
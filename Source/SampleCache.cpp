@@ -0,0 +1,175 @@
+#include "SampleCache.h"
+
+using namespace juce;
+
+// Polyphase table: numPhases sub-sample positions (plus one guard row for interpolation)
+// of a numTaps-long Kaiser-windowed sinc.
+static constexpr int numTaps   = 64;
+static constexpr int numPhases = 256;
+static constexpr double kaiserBeta = 9.0;
+
+static double besselI0 (double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// ===================== Cache =====================
+SampleCache::~SampleCache()
+{
+    pool.removeAllJobs (true, 5000);
+}
+
+String SampleCache::makeKey (const File& file, double targetRate, int maxSamples)
+{
+    return file.getFullPathName()
+         + "|" + String (file.getLastModificationTime().toMilliseconds())
+         + "|" + String (targetRate)
+         + "|" + String (maxSamples);
+}
+
+void SampleCache::request (const File& file, double targetRate, int maxSamples, Callback onDone)
+{
+    const auto key = makeKey (file, targetRate, maxSamples);
+    Buffer hit;
+    {
+        const ScopedLock sl (lock);
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->key == key)
+            {
+                auto entry = *it;
+                entries.erase (it);
+                entries.push_back (entry); // mark as most recently used
+                hit = entry.audio;
+                break;
+            }
+        }
+    }
+
+    // Outside the lock: the callback may do real work, or request again
+    if (hit != nullptr)
+    {
+        onDone (hit);
+        return;
+    }
+
+    pool.addJob ([this, file, targetRate, maxSamples, key, onDone]
+    {
+        auto converted = decodeAndConvert (file, targetRate, maxSamples);
+        if (converted != nullptr)
+        {
+            const ScopedLock sl (lock);
+            entries.push_back ({ key, converted });
+            if (entries.size() > maxEntries)
+                entries.erase (entries.begin());
+        }
+
+        MessageManager::callAsync ([onDone, converted] { onDone (converted); });
+    });
+}
+
+SampleCache::Buffer SampleCache::decodeAndConvert (const File& file, double targetRate, int maxSamples)
+{
+    AudioFormatManager fm; fm.registerBasicFormats();
+    std::unique_ptr<AudioFormatReader> reader (fm.createReaderFor (file));
+    if (reader == nullptr || reader->sampleRate <= 0.0 || maxSamples <= 0)
+        return {};
+
+    // Read only the tail we need (+ filter support), since snapshots keep the most recent audio
+    const double ratio = reader->sampleRate / targetRate;
+    const int64 wanted = (int64) std::ceil (maxSamples * ratio) + numTaps;
+    const int   toRead = (int) std::min (reader->lengthInSamples, wanted);
+
+    AudioBuffer<float> raw ((int) reader->numChannels, toRead);
+    reader->read (&raw, 0, toRead, reader->lengthInSamples - toRead, true, true);
+
+    const auto converted = resample (raw, reader->sampleRate, targetRate);
+
+    // Crop to the last maxSamples, or pad with silence if shorter (same as a raw load)
+    auto out = std::make_shared<AudioBuffer<float>> (converted.getNumChannels(), maxSamples);
+    out->clear();
+    const int n = std::min (converted.getNumSamples(), maxSamples);
+    for (int ch = 0; ch < out->getNumChannels(); ++ch)
+        out->copyFrom (ch, 0, converted, ch, converted.getNumSamples() - n, n);
+
+    return out;
+}
+
+// ===================== Resampler =====================
+AudioBuffer<float> SampleCache::resample (const AudioBuffer<float>& src, double srcRate, double dstRate)
+{
+    if (srcRate <= 0.0 || dstRate <= 0.0 || std::abs (srcRate - dstRate) < 1.0e-6)
+        return src;
+
+    const int numCh  = src.getNumChannels();
+    const int inLen  = src.getNumSamples();
+    const double step = srcRate / dstRate; // input samples per output sample
+    const int outLen = (int) std::floor (inLen / step);
+
+    // Anti-alias when going down in rate: cutoff relative to input Nyquist
+    const double cutoff = std::min (1.0, dstRate / srcRate) * 0.95;
+    constexpr int half = numTaps / 2;
+
+    // Row p holds the taps for an output falling p/numPhases past an input sample.
+    // Tap k reads input (i - half + 1 + k); each row is normalised to unity DC gain.
+    std::vector<float> table ((size_t) (numPhases + 1) * numTaps);
+    for (int p = 0; p <= numPhases; ++p)
+    {
+        const double frac = (double) p / numPhases;
+        double sum = 0.0;
+        for (int k = 0; k < numTaps; ++k)
+        {
+            const double d = (k - half + 1) - frac;
+            const double x = MathConstants<double>::pi * cutoff * d;
+            const double sinc = std::abs (x) < 1.0e-9 ? 1.0 : std::sin (x) / x;
+            const double r = d / half;
+            const double w = std::abs (r) >= 1.0 ? 0.0 : besselI0 (kaiserBeta * std::sqrt (1.0 - r * r)) / besselI0 (kaiserBeta);
+            const double h = cutoff * sinc * w;
+            table[(size_t) p * numTaps + (size_t) k] = (float) h;
+            sum += h;
+        }
+        for (int k = 0; k < numTaps; ++k)
+            table[(size_t) p * numTaps + (size_t) k] /= (float) sum;
+    }
+
+    AudioBuffer<float> out (numCh, std::max (0, outLen));
+    std::vector<float> padded ((size_t) inLen + 2 * numTaps);
+
+    for (int ch = 0; ch < numCh; ++ch)
+    {
+        // Zero padding on both sides so every tap window stays in range
+        std::fill (padded.begin(), padded.end(), 0.0f);
+        std::copy (src.getReadPointer (ch), src.getReadPointer (ch) + inLen, padded.begin() + numTaps);
+
+        auto* dst = out.getWritePointer (ch);
+        for (int n = 0; n < outLen; ++n)
+        {
+            const double t = n * step;
+            const int    i = (int) t;
+            const float  phase = (float) ((t - i) * numPhases);
+            const int    p0 = std::min ((int) phase, numPhases - 1);
+            const float  pf = phase - (float) p0;
+
+            const float* x  = padded.data() + numTaps + i - half + 1;
+            const float* h0 = table.data() + (size_t) p0 * numTaps;
+            const float* h1 = h0 + numTaps;
+
+            // Four independent lanes: no loop-carried dependency, so the
+            // compiler packs this into SIMD multiply-adds
+            float acc[4] = {};
+            for (int k = 0; k < numTaps; k += 4)
+                for (int l = 0; l < 4; ++l)
+                    acc[l] += x[k + l] * (h0[k + l] + pf * (h1[k + l] - h0[k + l]));
+
+            dst[n] = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+        }
+    }
+
+    return out;
+}
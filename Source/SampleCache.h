@@ -0,0 +1,41 @@
+#pragma once
+#include <juce_audio_formats/juce_audio_formats.h>
+
+// Process-wide cache of user WAVs converted to a session sample rate. Decoding and
+// resampling run on a worker thread; results are keyed by (file, modification time,
+// target rate, length), so rate switches and new instances reuse finished conversions.
+// Hold it through juce::SharedResourcePointer<SampleCache>.
+class SampleCache
+{
+public:
+    using Buffer   = std::shared_ptr<const juce::AudioBuffer<float>>;
+    using Callback = std::function<void (Buffer)>; // nullptr on failure
+
+    SampleCache() = default;
+    ~SampleCache();
+
+    // Message thread. Converts the last maxSamples (at targetRate) of the file, cropped or
+    // padded like a snapshot. The callback runs on the message thread, immediately on a hit.
+    void request (const juce::File& file, double targetRate, int maxSamples, Callback onDone);
+
+    // Windowed-sinc polyphase conversion, usable on its own (e.g. for samples restored from state)
+    static juce::AudioBuffer<float> resample (const juce::AudioBuffer<float>& src, double srcRate, double dstRate);
+
+private:
+    static juce::String makeKey (const juce::File& file, double targetRate, int maxSamples);
+    static Buffer decodeAndConvert (const juce::File& file, double targetRate, int maxSamples);
+
+    struct Entry
+    {
+        juce::String key;
+        Buffer audio;
+    };
+
+    static constexpr size_t maxEntries = 8;
+
+    juce::CriticalSection lock;
+    std::vector<Entry> entries;   // most recently used last
+    juce::ThreadPool pool { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE (SampleCache)
+};
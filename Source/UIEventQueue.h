@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Typed UI -> DSP event (on-screen keyboard, pitch wheel, export)
+struct UIEvent
+{
+    enum class Type : uint8_t { noteOn, noteOff, pitchBend, exportAudio };
+
+    Type  type = Type::noteOn;
+    int   value = 0;          // note number, 14-bit bend (0..16383) or raw export
+    float velocity = 0.0f;
+
+    static UIEvent noteOn (int note, float vel)            { return { Type::noteOn, note, vel }; }
+    static UIEvent noteOff (int note)                      { return { Type::noteOff, note, 0.0f }; }
+    static UIEvent pitchBend (int value14)                 { return { Type::pitchBend, value14, 0.0f }; }
+    static UIEvent exportAudio (bool rawSnapshot)          { return { Type::exportAudio, rawSnapshot ? 1 : 0, 0.0f }; }
+};
+
+// Wait-free single-producer / single-consumer ring. Storage is inline, so nothing
+// allocates after construction. Producer: message thread. Consumer: audio thread.
+template <typename Event, int Capacity>
+class SpscQueue
+{
+    static_assert (Capacity > 1 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer. Returns false (event dropped) when full.
+    bool push (const Event& e) noexcept
+    {
+        const auto t = tail.load (std::memory_order_relaxed);
+        if (t - head.load (std::memory_order_acquire) == (uint32_t) Capacity)
+            return false;
+
+        items[t & mask] = e;
+        tail.store (t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer. Returns false when empty.
+    bool pop (Event& e) noexcept
+    {
+        const auto h = head.load (std::memory_order_relaxed);
+        if (h == tail.load (std::memory_order_acquire))
+            return false;
+
+        e = items[h & mask];
+        head.store (h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr uint32_t mask = (uint32_t) Capacity - 1;
+
+    std::array<Event, (std::size_t) Capacity> items {};
+    alignas (64) std::atomic<uint32_t> head { 0 }; // written by the consumer only
+    alignas (64) std::atomic<uint32_t> tail { 0 }; // written by the producer only
+};